@@ -3,7 +3,6 @@ CONFIG_SWI = 0
 CONFIG_PTHREAD_MAX_NUM = 32
 CONFIG_TIMESLICE = 10
 CONFIG_DEBUG = 1
-CONFIG_TIMER_MAX_NUM = 32
 CONFIG_HZ = 100
 CONFIG_PROMPT = "turnix \# "
 CONFIG_MOTD = "\nTurnix Copyright(C) 2015 Changli Gao <xiaosuo@gmail.com>\n\n"
@@ -11,3 +10,7 @@ CONFIG_LINE_MAX = 2048
 CONFIG_RR = 1
 CONFIG_TZ = -480
 CONFIG_IDLE_STACK_SIZE = 1024
+CONFIG_SMP = 0
+CONFIG_NO_HZ = 1
+CONFIG_TIMER_SLACK_NS = 50000
+CONFIG_IDLE_POLL_NS = 0
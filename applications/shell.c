@@ -32,6 +32,7 @@
 #include <shell.h>
 #include <timer.h>
 #include <hexdump.h>
+#include <idle.h>
 
 #include <sys/utsname.h>
 
@@ -282,9 +283,14 @@ static void show_thread(pthread_t th)
 		[PTHREAD_STATE_EXIT]		= "exit",
 	};
 
-	printf("%s %p %u %lu %ld.%03ld %s\n", state_str[th->state], th,
-	       th->priority, stack_check_size(th), th->stime.tv_sec,
-	       th->stime.tv_usec / USECS_PER_MSEC, th->name);
+	struct timespec time, wait;
+
+	ns_to_timespec(pthread_cputime(th), &time);
+	ns_to_timespec(th->wait_time, &wait);
+	printf("%s %p %u %lu %ld.%03ld %ld.%03ld %lu %lu %s\n",
+	       state_str[th->state], th, th->priority, stack_check_size(th),
+	       time.tv_sec, time.tv_nsec / NSECS_PER_MSEC, wait.tv_sec,
+	       wait.tv_nsec / NSECS_PER_MSEC, th->nvcsw, th->nivcsw, th->name);
 }
 
 static int do_ps(int argc, char *argv[])
@@ -292,7 +298,7 @@ static int do_ps(int argc, char *argv[])
 	(void)argc;
 	(void)argv;
 
-	printf("state tid priority stack time name\n");
+	printf("state tid priority stack time wait vcsw ivcsw name\n");
 	pthread_foreach(show_thread);
 
 	return 0;
@@ -303,6 +309,56 @@ static __shell_cmd struct shell_cmd cmd_ps = {
 	.handler	= do_ps,
 };
 
+static int do_idle(int argc, char *argv[])
+{
+	static const char * const mode_str[] = {
+		[IDLE_HALT]	= "halt",
+		[IDLE_MWAIT]	= "mwait",
+	};
+	struct idle_stats stats;
+	struct timespec ts;
+	int i;
+
+	if (argc == 2) {
+		for (i = 0; i < IDLE_MODE_NUM; ++i) {
+			if (strcmp(argv[1], mode_str[i]) == 0)
+				break;
+		}
+		if (i == IDLE_MODE_NUM || idle_set_mode(i) != 0) {
+			printf("invalid mode\n");
+			return -1;
+		}
+		return 0;
+	} else if (argc == 3 && strcmp(argv[1], "poll") == 0) {
+		idle_set_poll_ns(strtoul(argv[2], NULL, 0));
+		return 0;
+	} else if (argc != 1) {
+		printf("invalid arguments\n");
+		return -1;
+	}
+
+	idle_get_stats(&stats);
+	printf("mode %s poll %lu ns\n", mode_str[idle_get_mode()],
+	       idle_get_poll_ns());
+	ns_to_timespec(stats.poll_ns, &ts);
+	printf("poll %lu hits %lu time %ld.%03ld\n", stats.poll_entries,
+	       stats.poll_hits, ts.tv_sec, ts.tv_nsec / NSECS_PER_MSEC);
+	for (i = 0; i < IDLE_MODE_NUM; ++i) {
+		ns_to_timespec(stats.residency_ns[i], &ts);
+		printf("%s %lu time %ld.%03ld\n", mode_str[i],
+		       stats.entries[i], ts.tv_sec,
+		       ts.tv_nsec / NSECS_PER_MSEC);
+	}
+
+	return 0;
+}
+
+static __shell_cmd struct shell_cmd cmd_idle = {
+	.exe		= "idle",
+	.handler	= do_idle,
+	.usage		= "idle [halt|mwait|poll ns]",
+};
+
 static int do_hexdump(int argc, char *argv[])
 {
 	if (argc != 3) {
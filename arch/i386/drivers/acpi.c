@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <acpi.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+enum {
+	ACPI_EBDA_SEG_PTR	= 0x40e,
+	ACPI_BIOS_BEGIN		= 0xe0000,
+	ACPI_BIOS_END		= 0x100000,
+	ACPI_RSDP_LEN		= 20,
+};
+
+static bool acpi_checksum(const void *ptr, size_t len)
+{
+	const uint8_t *p = ptr;
+	uint8_t sum = 0;
+
+	while (len-- > 0)
+		sum += *p++;
+
+	return sum == 0;
+}
+
+static const uint8_t *acpi_find_rsdp_in(unsigned long begin, unsigned long end)
+{
+	const uint8_t *p;
+
+	for (p = (const uint8_t *)begin; p < (const uint8_t *)end; p += 16) {
+		if (memcmp(p, "RSD PTR ", 8) == 0 &&
+		    acpi_checksum(p, ACPI_RSDP_LEN))
+			return p;
+	}
+
+	return NULL;
+}
+
+static const uint8_t *acpi_find_rsdp(void)
+{
+	const uint16_t *seg = (const uint16_t *)ACPI_EBDA_SEG_PTR;
+	const uint8_t *rsdp = NULL;
+	unsigned long ebda;
+
+	/* Hide the low address from gcc, which takes it for a NULL offset. */
+	asm("" : "+r"(seg));
+	ebda = (unsigned long)*seg << 4;
+	if (ebda)
+		rsdp = acpi_find_rsdp_in(ebda, ebda + 1024);
+	if (!rsdp)
+		rsdp = acpi_find_rsdp_in(ACPI_BIOS_BEGIN, ACPI_BIOS_END);
+
+	return rsdp;
+}
+
+const struct acpi_sdt_header *acpi_find_table(const char *signature)
+{
+	const uint8_t *rsdp = acpi_find_rsdp();
+	const struct acpi_sdt_header *rsdt, *sdt;
+	const uint32_t *entry;
+	size_t i, n;
+
+	if (!rsdp)
+		return NULL;
+	rsdt = (const struct acpi_sdt_header *)*(const uint32_t *)(rsdp + 16);
+	if (memcmp(rsdt->signature, "RSDT", 4) != 0 ||
+	    !acpi_checksum(rsdt, rsdt->length))
+		return NULL;
+	entry = (const uint32_t *)(rsdt + 1);
+	n = (rsdt->length - sizeof(*rsdt)) / sizeof(*entry);
+	for (i = 0; i < n; ++i) {
+		sdt = (const struct acpi_sdt_header *)entry[i];
+		if (memcmp(sdt->signature, signature, 4) == 0 &&
+		    acpi_checksum(sdt, sdt->length))
+			return sdt;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * ACPI power management timer
+ */
+
+#include <acpi_pm.h>
+#include <acpi.h>
+#include <clocksource.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sys/io.h>
+
+enum {
+	ACPI_PM_HZ		= 3579545,
+	ACPI_PM_MASK_24		= 0xffffff,
+	ACPI_PM_MASK_32		= 0xffffffff,
+	ACPI_FADT_PM_TMR_BLK	= 76,
+	ACPI_FADT_FLAGS		= 112,
+	ACPI_FADT_TMR_VAL_EXT	= 0x100
+};
+
+static unsigned short acpi_pm_port;
+
+static uint64_t acpi_pm_read(void)
+{
+	return inl(acpi_pm_port);
+}
+
+static struct clocksource acpi_pm_clocksource = {
+	.name	= "acpi_pm",
+	.rating	= 200,
+	.read	= acpi_pm_read,
+	.mask	= ACPI_PM_MASK_24,
+};
+
+void acpi_pm_init(void)
+{
+	const struct acpi_sdt_header *fadt = acpi_find_table("FACP");
+	const uint8_t *p = (const uint8_t *)fadt;
+
+	if (!fadt || fadt->length < ACPI_FADT_FLAGS + 4)
+		return;
+	acpi_pm_port = *(const uint32_t *)(p + ACPI_FADT_PM_TMR_BLK);
+	if (!acpi_pm_port)
+		return;
+	if (*(const uint32_t *)(p + ACPI_FADT_FLAGS) & ACPI_FADT_TMR_VAL_EXT)
+		acpi_pm_clocksource.mask = ACPI_PM_MASK_32;
+	clocksource_register_hz(&acpi_pm_clocksource, ACPI_PM_HZ);
+}
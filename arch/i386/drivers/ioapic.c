@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * I/O APIC
+ *
+ * The ISA interrupts keep the vectors they have on the 8259A, and are sent to
+ * the boot CPU.
+ */
+
+#include <ioapic.h>
+#include <lapic.h>
+#include <acpi.h>
+#include <arch.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+	IOAPIC_REGSEL		= 0x00,
+	IOAPIC_WIN		= 0x10,
+};
+
+enum {
+	IOAPIC_REG_VER		= 0x01,
+	IOAPIC_REG_REDTBL	= 0x10,
+};
+
+enum {
+	IOAPIC_REDTBL_LOW	= 0x2000,
+	IOAPIC_REDTBL_LEVEL	= 0x8000,
+	IOAPIC_REDTBL_MASKED	= 0x10000,
+};
+
+enum {
+	IOAPIC_MAX		= 4,
+	IOAPIC_IRQ_BASE		= 32,
+	IOAPIC_ISA_IRQ_NUM	= 16,
+};
+
+struct ioapic {
+	volatile uint32_t	*base;
+	uint32_t		gsi_base;
+	unsigned int		pin_num;
+};
+
+static struct ioapic ioapics[IOAPIC_MAX];
+static unsigned int ioapic_num;
+
+/* Where the ISA interrupts are wired. */
+static struct {
+	struct ioapic	*ioapic;  /* NULL if the GSI is taken by another */
+	unsigned int	pin;
+	uint32_t	gsi;
+	uint32_t	entry;  /* the low half of the redirection entry */
+} ioapic_irqs[IOAPIC_ISA_IRQ_NUM];
+
+static uint32_t ioapic_read(struct ioapic *ioapic, unsigned int reg)
+{
+	ioapic->base[IOAPIC_REGSEL / 4] = reg;
+
+	return ioapic->base[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(struct ioapic *ioapic, unsigned int reg,
+			 uint32_t value)
+{
+	ioapic->base[IOAPIC_REGSEL / 4] = reg;
+	ioapic->base[IOAPIC_WIN / 4] = value;
+}
+
+static struct ioapic *ioapic_find(uint32_t gsi)
+{
+	unsigned int i;
+
+	for (i = 0; i < ioapic_num; ++i) {
+		if (gsi >= ioapics[i].gsi_base &&
+		    gsi - ioapics[i].gsi_base < ioapics[i].pin_num)
+			return &ioapics[i];
+	}
+
+	return NULL;
+}
+
+/* The EOI of the local APIC is a single write. */
+static void ioapic_ack(unsigned int irq)
+{
+	if (irq - IOAPIC_IRQ_BASE < IOAPIC_ISA_IRQ_NUM)
+		lapic_eoi();
+}
+
+static void ioapic_set_masked(unsigned int irq, bool masked)
+{
+	unsigned long flags;
+	uint32_t entry;
+
+	irq -= IOAPIC_IRQ_BASE;
+	if (irq >= IOAPIC_ISA_IRQ_NUM || !ioapic_irqs[irq].ioapic)
+		return;
+	entry = ioapic_irqs[irq].entry;
+	if (masked)
+		entry |= IOAPIC_REDTBL_MASKED;
+	/* No read back, as the entry is known. */
+	flags = interrupt_disable();
+	ioapic_write(ioapic_irqs[irq].ioapic,
+		     IOAPIC_REG_REDTBL + ioapic_irqs[irq].pin * 2, entry);
+	interrupt_enable(flags);
+}
+
+static void ioapic_enable(unsigned int irq)
+{
+	ioapic_set_masked(irq, false);
+}
+
+static void ioapic_disable(unsigned int irq)
+{
+	ioapic_set_masked(irq, true);
+}
+
+struct irq_chip ioapic_irq_chip = {
+	.name		= "I/O APIC",
+	.ack		= ioapic_ack,
+	.enable		= ioapic_enable,
+	.disable	= ioapic_disable,
+};
+
+static void ioapic_add(const struct acpi_madt_ioapic *madt_ioapic)
+{
+	struct ioapic *ioapic;
+
+	if (ioapic_num >= IOAPIC_MAX)
+		return;
+	ioapic = &ioapics[ioapic_num++];
+	ioapic->base = (volatile uint32_t *)madt_ioapic->addr;
+	ioapic->gsi_base = madt_ioapic->gsi_base;
+	ioapic->pin_num = ((ioapic_read(ioapic, IOAPIC_REG_VER) >> 16) &
+			   0xff) + 1;
+}
+
+static void ioapic_override(const struct acpi_madt_iso *iso)
+{
+	unsigned int irq;
+
+	if (iso->bus != 0 || iso->source >= IOAPIC_ISA_IRQ_NUM)
+		return;
+	/* The interrupt whose GSI is taken, e.g. the cascade, is lost. */
+	for (irq = 0; irq < IOAPIC_ISA_IRQ_NUM; ++irq) {
+		if (irq != iso->source && ioapic_irqs[irq].gsi == iso->gsi)
+			ioapic_irqs[irq].ioapic = NULL;
+	}
+	irq = iso->source;
+	ioapic_irqs[irq].gsi = iso->gsi;
+	ioapic_irqs[irq].entry = IOAPIC_IRQ_BASE + irq;
+	if ((iso->flags & ACPI_MADT_ISO_POLARITY_MASK) ==
+	    ACPI_MADT_ISO_POLARITY_LOW)
+		ioapic_irqs[irq].entry |= IOAPIC_REDTBL_LOW;
+	if ((iso->flags & ACPI_MADT_ISO_TRIGGER_MASK) ==
+	    ACPI_MADT_ISO_TRIGGER_LEVEL)
+		ioapic_irqs[irq].entry |= IOAPIC_REDTBL_LEVEL;
+	ioapic_irqs[irq].ioapic = ioapic_find(iso->gsi);
+}
+
+bool ioapic_init(void)
+{
+	const struct acpi_madt *madt;
+	const struct acpi_madt_entry *entry;
+	struct ioapic *ioapic;
+	unsigned int i, pin;
+	uint32_t dest;
+
+	madt = (const struct acpi_madt *)acpi_find_table("APIC");
+	if (!madt)
+		return false;
+	acpi_madt_foreach(madt, entry) {
+		if (entry->type == ACPI_MADT_TYPE_IOAPIC)
+			ioapic_add((const struct acpi_madt_ioapic *)entry);
+	}
+	if (ioapic_num == 0)
+		return false;
+	lapic_set_base(madt->lapic_addr);
+	if (!lapic_init())
+		return false;
+
+	/* The ISA interrupts are edge triggered and active high by default. */
+	for (i = 0; i < IOAPIC_ISA_IRQ_NUM; ++i) {
+		ioapic_irqs[i].gsi = i;
+		ioapic_irqs[i].entry = IOAPIC_IRQ_BASE + i;
+		ioapic_irqs[i].ioapic = ioapic_find(i);
+	}
+	acpi_madt_foreach(madt, entry) {
+		if (entry->type == ACPI_MADT_TYPE_ISO)
+			ioapic_override((const struct acpi_madt_iso *)entry);
+	}
+
+	for (i = 0; i < ioapic_num; ++i) {
+		ioapic = &ioapics[i];
+		for (pin = 0; pin < ioapic->pin_num; ++pin) {
+			ioapic_write(ioapic, IOAPIC_REG_REDTBL + pin * 2,
+				     IOAPIC_REDTBL_MASKED);
+		}
+	}
+	dest = lapic_id() << 24;
+	for (i = 0; i < IOAPIC_ISA_IRQ_NUM; ++i) {
+		ioapic = ioapic_irqs[i].ioapic;
+		if (!ioapic)
+			continue;
+		ioapic_irqs[i].pin = ioapic_irqs[i].gsi - ioapic->gsi_base;
+		ioapic_write(ioapic, IOAPIC_REG_REDTBL + ioapic_irqs[i].pin * 2,
+			     ioapic_irqs[i].entry | IOAPIC_REDTBL_MASKED);
+		ioapic_write(ioapic,
+			     IOAPIC_REG_REDTBL + ioapic_irqs[i].pin * 2 + 1,
+			     dest);
+	}
+
+	return true;
+}
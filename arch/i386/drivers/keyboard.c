@@ -28,11 +28,12 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <interrupt.h>
-#include <pic.h>
+#include <irq_chip.h>
 #include <ctype.h>
 #include <circular_buffer.h>
 #include <kernel.h>
 #include <pthread.h>
+#include <event.h>
 
 #include <sys/io.h>
 
@@ -46,6 +47,10 @@ enum {
 	KEYBOARD_PORT_CMD	= 0x64
 };
 
+enum {
+	KEYBOARD_EVENT_INPUT	= 0x01
+};
+
 static struct {
 	union {
 		struct {
@@ -66,7 +71,7 @@ static struct {
 	uint8_t	esc;
 	struct circular_buffer	cb;
 	uint8_t			buffer[1024];
-	pthread_t		waiter;
+	event_t			event;
 } keyboard;
 
 static const uint8_t scan_code[3][0x3a] = {
@@ -339,8 +344,7 @@ void keyboard_handler(struct interrupt_context *ctx)
 		if (bare_code < ARRAY_SIZE(transcode_func_table))
 			transcode_func_table[bare_code](code);
 		keyboard.esc = 0;
-		if (keyboard.waiter)
-			wake_up(keyboard.waiter);
+		event_set(&keyboard.event, KEYBOARD_EVENT_INPUT);
 		break;
 	}
 }
@@ -351,11 +355,8 @@ int getchar(void)
 	unsigned long flags = interrupt_disable();
 
 	while (circular_buffer_read(&keyboard.cb, &code, 1) <= 0) {
-		assert(keyboard.waiter == NULL);
-		keyboard.waiter = pthread_current;
-		pthread_current->state = PTHREAD_STATE_SLEEPING;
-		schedule();
-		keyboard.waiter = NULL;
+		event_wait(&keyboard.event, KEYBOARD_EVENT_INPUT, EVENT_CLEAR,
+			   NULL);
 	}
 	interrupt_enable(flags);
 
@@ -366,8 +367,9 @@ void keyboard_init(void)
 {
 	circular_buffer_init(&keyboard.cb, keyboard.buffer,
 			     sizeof(keyboard.buffer));
+	event_init(&keyboard.event, 0);
 	interrupt_register(KEYBOARD_IRQ, keyboard_handler);
-	pic_enable(KEYBOARD_IRQ);
+	irq_enable(KEYBOARD_IRQ);
 }
 
 void reboot(void)
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Local APIC
+ */
+
+#include <lapic.h>
+#include <interrupt.h>
+#include <timer.h>
+#include <clocksource.h>
+#include <pit.h>
+#include <tsc.h>
+#include <arch.h>
+
+#include <sys/param.h>
+
+enum {
+	LAPIC_ID		= 0x20,
+	LAPIC_TPR		= 0x80,
+	LAPIC_EOI		= 0xb0,
+	LAPIC_SVR		= 0xf0,
+	LAPIC_ICR_LOW		= 0x300,
+	LAPIC_ICR_HIGH		= 0x310,
+	LAPIC_LVT_TIMER		= 0x320,
+	LAPIC_LVT_LINT0		= 0x350,
+	LAPIC_LVT_LINT1		= 0x360,
+	LAPIC_TIMER_ICR		= 0x380,  /* the initial count */
+	LAPIC_TIMER_CCR		= 0x390,  /* the current count */
+	LAPIC_TIMER_DCR		= 0x3e0,  /* the divide configuration */
+};
+
+enum {
+	LAPIC_SVR_ENABLE	= 0x100,
+	LAPIC_LVT_MASKED	= 0x10000,
+	LAPIC_ICR_INIT		= 0x500,
+	LAPIC_ICR_STARTUP	= 0x600,
+	LAPIC_ICR_PENDING	= 0x1000,
+	LAPIC_ICR_ASSERT	= 0x4000,
+	LAPIC_ICR_LEVEL		= 0x8000,
+	LAPIC_TIMER_DIV_16	= 0x3,
+	LAPIC_TIMER_DEADLINE	= 0x40000,
+};
+
+enum {
+	CPUID_1_EDX_APIC	= 0x200,
+	MSR_APIC_BASE		= 0x1b,
+	MSR_APIC_BASE_BSP	= 0x100,
+	MSR_APIC_BASE_ENABLE	= 0x800,
+	CPUID_1_ECX_DEADLINE	= 0x1000000,
+	MSR_TSC_DEADLINE	= 0x6e0,
+};
+
+enum {
+	LAPIC_TIMER_COUNT_MAX	= 0xffffffff,
+	LAPIC_TIMER_MAXSEC	= 10,
+	LAPIC_TIMER_MIN_NS	= 1000,
+};
+
+static volatile uint32_t *lapic_base = (volatile uint32_t *)0xfee00000;
+static bool lapic_enabled;  /* on the boot CPU */
+
+/*
+ * The timer counts down at the bus clock divided by 16, or is armed with an
+ * absolute TSC value in the TSC-deadline mode.
+ */
+static struct {
+	uint32_t	mult;  /* counts or cycles = (ns * mult) >> shift */
+	uint32_t	shift;
+} lapic_timer;
+
+static inline uint32_t lapic_read(unsigned int reg)
+{
+	return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(unsigned int reg, uint32_t value)
+{
+	lapic_base[reg / 4] = value;
+}
+
+/* Needs no EOI. */
+static void lapic_spurious_interrupt(struct interrupt_context *ctx)
+{
+	(void)ctx;
+}
+
+void lapic_set_base(uint32_t base)
+{
+	lapic_base = (volatile uint32_t *)base;
+}
+
+bool lapic_init(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t msr;
+
+	if (!cpu_has_cpuid())
+		return false;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_1_EDX_APIC))
+		return false;
+	msr = rdmsr(MSR_APIC_BASE);
+	if (!(msr & MSR_APIC_BASE_ENABLE))
+		wrmsr(MSR_APIC_BASE, msr | MSR_APIC_BASE_ENABLE);
+
+	/* The boot CPU keeps LINT0 in the virtual wire mode for the 8259A. */
+	if (!(msr & MSR_APIC_BASE_BSP)) {
+		lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+		lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+	} else {
+		interrupt_register(LAPIC_SPURIOUS_VECTOR,
+				   lapic_spurious_interrupt);
+		lapic_enabled = true;
+	}
+	lapic_write(LAPIC_TPR, 0);
+	lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+	return true;
+}
+
+unsigned int lapic_id(void)
+{
+	return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi(void)
+{
+	lapic_write(LAPIC_EOI, 0);
+}
+
+static void lapic_send(unsigned int apic_id, uint32_t icr)
+{
+	while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+		cpu_relax();
+	lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+	lapic_write(LAPIC_ICR_LOW, icr);
+}
+
+void lapic_send_ipi(unsigned int apic_id, unsigned int vector)
+{
+	lapic_send(apic_id, LAPIC_ICR_ASSERT | vector);
+}
+
+void lapic_send_init(unsigned int apic_id)
+{
+	lapic_send(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+}
+
+/* The CPU starts in the real mode at addr, which must be page aligned. */
+void lapic_send_startup(unsigned int apic_id, uint32_t addr)
+{
+	lapic_send(apic_id, LAPIC_ICR_STARTUP | (addr >> 12));
+}
+
+/* A local interrupt, so no I/O APIC or 8259A acknowledges it. */
+static void lapic_timer_interrupt(struct interrupt_context *ctx)
+{
+	(void)ctx;
+	clock_event_handler();
+	lapic_eoi();
+}
+
+/* Reprogramming is a single write either way. */
+static void lapic_timer_set_next_event(uint64_t delta_ns)
+{
+	uint32_t counts = (delta_ns * lapic_timer.mult) >> lapic_timer.shift;
+
+	lapic_write(LAPIC_TIMER_ICR, MAX(counts, 1));
+}
+
+static void lapic_timer_set_deadline(uint64_t delta_ns)
+{
+	wrmsr(MSR_TSC_DEADLINE,
+	      rdtsc() + ((delta_ns * lapic_timer.mult) >> lapic_timer.shift));
+}
+
+static struct clock_event lapic_clock_event = {
+	.name		= "lapic",
+	.rating		= 200,
+	.set_next_event	= lapic_timer_set_next_event,
+};
+
+static uint64_t lapic_timer_elapsed(void)
+{
+	return LAPIC_TIMER_COUNT_MAX - lapic_read(LAPIC_TIMER_CCR);
+}
+
+void lapic_timer_init(void)
+{
+	uint32_t eax, ebx, ecx, edx, khz;
+	uint64_t max_delta_ns = (uint64_t)LAPIC_TIMER_MAXSEC * NSECS_PER_SEC;
+	uint64_t delta_ns;
+
+	/* The PIT stops counting the time once it is replaced. */
+	if (!lapic_enabled || pit_clocksource_in_use())
+		return;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	if ((ecx & CPUID_1_ECX_DEADLINE) && tsc_khz > 0) {
+		khz = tsc_khz;
+		lapic_clock_event.name = "lapic-deadline";
+		lapic_clock_event.set_next_event = lapic_timer_set_deadline;
+		lapic_write(LAPIC_LVT_TIMER,
+			    LAPIC_TIMER_DEADLINE | LAPIC_TIMER_VECTOR);
+	} else {
+		lapic_write(LAPIC_TIMER_DCR, LAPIC_TIMER_DIV_16);
+		lapic_write(LAPIC_LVT_TIMER,
+			    LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+		lapic_write(LAPIC_TIMER_ICR, LAPIC_TIMER_COUNT_MAX);
+		khz = pit_calibrate_khz(lapic_timer_elapsed);
+		lapic_write(LAPIC_TIMER_ICR, 0);
+		if (khz == 0)
+			return;
+		lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+		delta_ns = (uint64_t)LAPIC_TIMER_COUNT_MAX * NSECS_PER_MSEC;
+		div64_32(&delta_ns, khz);
+		max_delta_ns = MIN(max_delta_ns, delta_ns);
+	}
+	clocks_calc_mult_shift(&lapic_timer.mult, &lapic_timer.shift,
+			       NSECS_PER_MSEC, khz,
+			       LAPIC_TIMER_MAXSEC * MSECS_PER_SEC);
+	lapic_clock_event.min_delta_ns = LAPIC_TIMER_MIN_NS;
+	lapic_clock_event.max_delta_ns = max_delta_ns;
+	interrupt_register(LAPIC_TIMER_VECTOR, lapic_timer_interrupt);
+	clock_event_register(&lapic_clock_event);
+}
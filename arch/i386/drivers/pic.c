@@ -70,6 +70,13 @@ void pic_init()
 	outb(0xff, PIC_PORT_DATA_SLAVE);
 }
 
+/* Silences the 8259A when the interrupts are routed elsewhere. */
+void pic_mask_all(void)
+{
+	outb(0xff, PIC_PORT_DATA_MASTER);
+	outb(0xff, PIC_PORT_DATA_SLAVE);
+}
+
 void pic_disable(unsigned int irq)
 {
 	irq -= PIC_IV_OFFSET_MASTER;
@@ -97,3 +104,10 @@ void pic_enable(unsigned int irq)
 		}
 	}
 }
+
+struct irq_chip pic_irq_chip = {
+	.name		= "8259A",
+	.ack		= pic_ack,
+	.enable		= pic_enable,
+	.disable	= pic_disable,
+};
@@ -30,10 +30,14 @@
 #include <pit.h>
 #include <interrupt.h>
 #include <stdio.h>
-#include <pic.h>
+#include <irq_chip.h>
 #include <timer.h>
+#include <clocksource.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include <sys/io.h>
+#include <sys/param.h>
 
 enum {
 	PIT_HZ		= 1193180,
@@ -41,25 +45,161 @@ enum {
 	PIT_PORT_CTRL	= 0x43,
 	PIT_CHAN	= 0,
 	PIT_LSB_MSB	= 3,
-	PIT_SQUARE	= 3,
-	PIT_PORT_CHAN	= 0x40
+	PIT_ONESHOT	= 0,
+	PIT_PORT_CHAN	= 0x40,
+	PIT_READ_BACK	= 0xc2,  /* latch the count and status of channel 0 */
+	PIT_STATUS_OUT	= 0x80,
+	PIT_STATUS_NULL	= 0x40,  /* the count hasn't been loaded yet */
+	PIT_COUNT_MIN	= 2,
+	PIT_COUNT_MAX	= 0xffff
 };
 
+/* Channel 2 is gated by the port B of the keyboard controller. */
+enum {
+	PIT_CHAN2		= 2,
+	PIT_PORT_CHAN2		= 0x42,
+	PIT_PORT_B		= 0x61,
+	PIT_PORT_B_GATE2	= 0x01,
+	PIT_PORT_B_SPEAKER	= 0x02,
+	PIT_PORT_B_OUT2		= 0x20,
+	PIT_CALIBRATE_MSECS	= 50
+};
+
+/*
+ * Channel 0 always runs in the one-shot mode. As a clock source, it counts the
+ * cycles of the periods programmed so far. The few cycles between latching
+ * the count and loading a new one are lost, so the better clock sources are
+ * preferred.
+ */
+static struct {
+	uint32_t	mult;  /* counts = (ns * mult) >> shift */
+	uint32_t	shift;
+	unsigned long	period;  /* counts of the current period */
+	uint64_t	cycles;  /* counted before the current period */
+	uint64_t	last;  /* read as the clock source */
+} pit;
+
+static void pit_program(unsigned long counts)
+{
+	outb((PIT_CHAN << 6) | (PIT_LSB_MSB << 4) | (PIT_ONESHOT << 1),
+	     PIT_PORT_CTRL);
+	outb(counts, PIT_PORT_CHAN);
+	outb(counts >> 8, PIT_PORT_CHAN);
+	pit.period = counts;
+}
+
+/*
+ * Returns the counts elapsed in the current period. OUT goes high when the
+ * period expires, and the counter keeps running down from 0xffff after that.
+ */
+static unsigned long pit_elapsed(void)
+{
+	uint8_t status;
+	unsigned long count;
+
+	outb(PIT_READ_BACK, PIT_PORT_CTRL);
+	status = inb(PIT_PORT_CHAN);
+	count = inb(PIT_PORT_CHAN);
+	count |= inb(PIT_PORT_CHAN) << 8;
+
+	if (status & PIT_STATUS_NULL)
+		return 0;
+	if (status & PIT_STATUS_OUT)
+		return pit.period + ((PIT_COUNT_MAX + 1 - count) & PIT_COUNT_MAX);
+
+	return pit.period - MIN(count, pit.period);
+}
+
 static void pic_handler(struct interrupt_context *ctx)
 {
 	(void)ctx;
-	timer_update();
+	clock_event_handler();
 }
 
-void pit_init(void)
+static void pit_set_next_event(uint64_t delta_ns)
+{
+	unsigned long counts = (delta_ns * pit.mult) >> pit.shift;
+
+	counts = MAX(counts, PIT_COUNT_MIN);
+	counts = MIN(counts, PIT_COUNT_MAX);
+	pit.cycles += pit_elapsed();
+	pit_program(counts);
+}
+
+static struct clock_event pit_clock_event = {
+	.name		= "pit",
+	.rating		= 100,
+	.set_next_event	= pit_set_next_event,
+};
+
+static uint64_t pit_read(void)
+{
+	uint64_t cycles;
+	unsigned long flags = interrupt_disable();
+
+	cycles = pit.cycles + pit_elapsed();
+	if (cycles < pit.last)
+		cycles = pit.last;
+	pit.last = cycles;
+	interrupt_enable(flags);
+
+	return cycles;
+}
+
+/*
+ * Rated below even the TSC that isn't invariant, as it loses cycles, and only
+ * counts while it is the clock event device.
+ */
+static struct clocksource pit_clocksource = {
+	.name	= "pit",
+	.rating	= 50,
+	.read	= pit_read,
+	.mask	= ~0ULL,
+};
+
+/* It counts the time only while the PIT is the clock event device. */
+bool pit_clocksource_in_use(void)
+{
+	return timekeeping_clocksource() == &pit_clocksource;
+}
+
+uint32_t pit_calibrate_khz(uint64_t (*read)(void))
 {
-	int divisor = PIT_HZ / CONFIG_HZ;
+	uint64_t start, delta;
+	unsigned long latch = PIT_HZ / MSECS_PER_SEC * PIT_CALIBRATE_MSECS;
+	unsigned long flags = interrupt_disable();
 
-	outb((PIT_CHAN << 6) | (PIT_LSB_MSB << 4) | (PIT_SQUARE << 1),
+	outb((inb(PIT_PORT_B) & ~PIT_PORT_B_SPEAKER) | PIT_PORT_B_GATE2,
+	     PIT_PORT_B);
+	outb((PIT_CHAN2 << 6) | (PIT_LSB_MSB << 4) | (PIT_ONESHOT << 1),
 	     PIT_PORT_CTRL);
-	outb(divisor, PIT_PORT_CHAN);
-	outb(divisor >> 8, PIT_PORT_CHAN);
+	outb(latch, PIT_PORT_CHAN2);
+	outb(latch >> 8, PIT_PORT_CHAN2);
+	start = read();
+	while (!(inb(PIT_PORT_B) & PIT_PORT_B_OUT2))
+		;
+	delta = read() - start;
+	interrupt_enable(flags);
+	div64_32(&delta, PIT_CALIBRATE_MSECS);
+
+	return delta;
+}
+
+void pit_init(void)
+{
+	uint32_t mult, shift;
+
+	clocks_calc_mult_shift(&pit.mult, &pit.shift, NSECS_PER_SEC, PIT_HZ,
+			       CLOCKSOURCE_MAXSEC);
+	clocks_calc_mult_shift(&mult, &shift, PIT_HZ, NSECS_PER_SEC,
+			       CLOCKSOURCE_MAXSEC);
+	pit_clock_event.min_delta_ns = ((uint64_t)PIT_COUNT_MIN * mult) >> shift;
+	pit_clock_event.max_delta_ns = ((uint64_t)PIT_COUNT_MAX * mult) >> shift;
+	pit_program(PIT_HZ / CONFIG_HZ);
 
 	interrupt_register(PIT_IRQ, pic_handler);
-	pic_enable(PIT_IRQ);
+	irq_enable(PIT_IRQ);
+
+	clocksource_register_hz(&pit_clocksource, PIT_HZ);
+	clock_event_register(&pit_clock_event);
 }
@@ -21,6 +21,11 @@ for i in 8 `seq 10 14`; do
 done
 
 cat <<EOF
+#if CONFIG_SMP
+IRQ(48)
+#endif
+IRQ(49)
+IRQ(63)
 #if CONFIG_SWI
 IRQ(128)
 #endif
@@ -28,7 +33,7 @@ IRQ(128)
 #if CONFIG_SWI
 #define IRQ_MAX 255
 #else
-#define IRQ_MAX 47
+#define IRQ_MAX 63
 #endif
 #endif
 EOF
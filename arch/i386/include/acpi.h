@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+struct acpi_sdt_header {
+	char		signature[4];
+	uint32_t	length;
+	uint8_t		revision;
+	uint8_t		checksum;
+	char		oem_id[6];
+	char		oem_table_id[8];
+	uint32_t	oem_revision;
+	uint32_t	creator_id;
+	uint32_t	creator_revision;
+} __attribute__((packed));
+
+/* Multiple APIC Description Table */
+struct acpi_madt {
+	struct acpi_sdt_header	header;
+	uint32_t		lapic_addr;
+	uint32_t		flags;
+} __attribute__((packed));
+
+struct acpi_madt_entry {
+	uint8_t	type;
+	uint8_t	length;
+} __attribute__((packed));
+
+/* Iterates over the entries following the MADT header. */
+#define acpi_madt_foreach(madt, entry) \
+	for (entry = (const struct acpi_madt_entry *)((madt) + 1); \
+	     (const char *)entry < \
+		(const char *)(madt) + (madt)->header.length && \
+	     entry->length > 0; \
+	     entry = (const void *)((const char *)entry + entry->length))
+
+enum {
+	ACPI_MADT_TYPE_LAPIC	= 0,
+	ACPI_MADT_TYPE_IOAPIC	= 1,
+	ACPI_MADT_TYPE_ISO	= 2,
+	ACPI_MADT_LAPIC_ENABLED	= 0x1,
+};
+
+struct acpi_madt_lapic {
+	struct acpi_madt_entry	entry;
+	uint8_t			processor_id;
+	uint8_t			apic_id;
+	uint32_t		flags;
+} __attribute__((packed));
+
+struct acpi_madt_ioapic {
+	struct acpi_madt_entry	entry;
+	uint8_t			ioapic_id;
+	uint8_t			reserved;
+	uint32_t		addr;
+	uint32_t		gsi_base;  /* the GSI of the first pin */
+} __attribute__((packed));
+
+enum {
+	ACPI_MADT_ISO_POLARITY_MASK	= 0x3,
+	ACPI_MADT_ISO_POLARITY_LOW	= 0x3,
+	ACPI_MADT_ISO_TRIGGER_MASK	= 0xc,
+	ACPI_MADT_ISO_TRIGGER_LEVEL	= 0xc,
+};
+
+/* Interrupt Source Override, which moves an ISA interrupt to another GSI */
+struct acpi_madt_iso {
+	struct acpi_madt_entry	entry;
+	uint8_t			bus;
+	uint8_t			source;
+	uint32_t		gsi;
+	uint16_t		flags;
+} __attribute__((packed));
+
+/* Returns the table with the signature, or NULL if there isn't a valid one. */
+const struct acpi_sdt_header *acpi_find_table(const char *signature);
+
+#endif  /* ACPI_H */
@@ -26,6 +26,7 @@
 #define ARCH_H
 
 #include <config.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #define KERNEL_CS 0x8
@@ -65,13 +66,48 @@ static inline void arch_context_switch(void)
 void arch_context_switch(void);
 #endif
 
+#if CONFIG_SMP
+/*
+ * The big lock is held by the CPU while its interrupts are disabled, so the
+ * sections of interrupt_disable() are still exclusive across the CPUs. The
+ * boot CPU holds it from the start.
+ */
+void big_lock_acquire(void);
+void big_lock_release(void);
+#endif
+
 static inline void arch_halt(void)
 {
 	asm volatile("hlt":::"memory");
 }
 
+/* The interrupts are enabled after hlt starts, so no wakeup is lost. */
+static inline void arch_safe_halt(void)
+{
+#if CONFIG_SMP
+	big_lock_release();
+#endif
+	asm volatile("sti; hlt":::"memory", "cc");
+}
+
+/*
+ * Like arch_safe_halt(), but it also wakes up on a write to the cache line of
+ * addr.
+ */
+static inline void arch_safe_mwait(const volatile void *addr)
+{
+	asm volatile("monitor" : : "a"(addr), "c"(0), "d"(0));
+#if CONFIG_SMP
+	big_lock_release();
+#endif
+	asm volatile("sti; mwait" : : "a"(0), "c"(0) : "memory", "cc");
+}
+
 static inline void arch_enable_interrupt(void)
 {
+#if CONFIG_SMP
+	big_lock_release();
+#endif
 	asm volatile("sti":::"memory", "cc");
 }
 
@@ -93,6 +129,102 @@ static inline void outb(unsigned char value, unsigned short port)
 		     : "a"(value), "dN"(port));
 }
 
+static inline uint32_t inl(unsigned short port)
+{
+	uint32_t value;
+
+	asm volatile("inl %1, %0"
+		     : "=a"(value)
+		     : "dN"(port));
+
+	return value;
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+	uint64_t value;
+
+	asm volatile("rdmsr" : "=A"(value) : "c"(msr));
+
+	return value;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+	asm volatile("wrmsr" : : "c"(msr), "A"(value));
+}
+
+static inline uint64_t rdtsc(void)
+{
+	uint64_t value;
+
+	asm volatile("rdtsc" : "=A"(value));
+
+	return value;
+}
+
+static inline void cpuid(uint32_t op, uint32_t *eax, uint32_t *ebx,
+			 uint32_t *ecx, uint32_t *edx)
+{
+	asm volatile("cpuid"
+		     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+		     : "0"(op), "2"(0));
+}
+
+enum {
+	CPU_FLAG_ID		= 0x200000,
+	CPUID_1_ECX_MONITOR	= 0x8,
+};
+
+static inline bool cpu_has_cpuid(void)
+{
+	unsigned long f1, f2;
+
+	asm volatile("pushfl\n\t"
+		     "pushfl\n\t"
+		     "popl %0\n\t"
+		     "movl %0, %1\n\t"
+		     "xorl %2, %0\n\t"
+		     "pushl %0\n\t"
+		     "popfl\n\t"
+		     "pushfl\n\t"
+		     "popl %0\n\t"
+		     "popfl"
+		     : "=&r"(f1), "=&r"(f2)
+		     : "ir"(CPU_FLAG_ID)
+		     : "cc");
+
+	return (f1 ^ f2) & CPU_FLAG_ID;
+}
+
+static inline bool cpu_has_mwait(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	if (!cpu_has_cpuid())
+		return false;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+
+	return ecx & CPUID_1_ECX_MONITOR;
+}
+
+/* There is no libgcc, so the 64-bit division is done with two divl. */
+static inline uint32_t div64_32(uint64_t *n, uint32_t base)
+{
+	uint32_t high = *n >> 32, low = *n, rem, quot_high = 0;
+
+	if (high >= base) {
+		quot_high = high / base;
+		high %= base;
+	}
+	asm("divl %2"
+	    : "=a"(low), "=d"(rem)
+	    : "rm"(base), "0"(low), "1"(high));
+	*n = ((uint64_t)quot_high << 32) | low;
+
+	return rem;
+}
+
 static inline unsigned long interrupt_disable(void)
 {
 	unsigned long flags;
@@ -103,12 +235,20 @@ static inline unsigned long interrupt_disable(void)
 		     : "=rm"(flags)
 		     :
 		     : "memory");
+#if CONFIG_SMP
+	if (flags & CPU_FLAG_IF)
+		big_lock_acquire();
+#endif
 
 	return flags;
 }
 
 static inline void interrupt_enable(unsigned long flags)
 {
+#if CONFIG_SMP
+	if (flags & CPU_FLAG_IF)
+		big_lock_release();
+#endif
 	asm volatile("push %0\n\t"
 		     "popf"
 		     :
@@ -116,11 +256,46 @@ static inline void interrupt_enable(unsigned long flags)
 		     : "memory", "cc");
 }
 
+/*
+ * The atomics below are only atomic against the other CPUs with the lock
+ * prefix, which is a waste on a uniprocessor, where a single instruction is
+ * atomic against the interrupts anyway. xchg is always locked.
+ */
+#if CONFIG_SMP
+#define LOCK_PREFIX	"lock; "
+#else
+#define LOCK_PREFIX	""
+#endif
+
+#define barrier()	asm volatile("":::"memory")
+
+/* Not every i386 has mfence, but a locked operation is a full barrier too. */
+static inline void mb(void)
+{
+	asm volatile("lock; addl $0, 0(%%esp)":::"memory", "cc");
+}
+
+#define rmb()		mb()
+#define wmb()		barrier()  /* stores aren't reordered with stores */
+
+#if CONFIG_SMP
+#define smp_mb()	mb()
+#define smp_rmb()	rmb()
+#define smp_wmb()	wmb()
+#else
+#define smp_mb()	barrier()
+#define smp_rmb()	barrier()
+#define smp_wmb()	barrier()
+#endif
+
+#define READ_ONCE(x)		(*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)	(*(volatile __typeof__(x) *)&(x) = (v))
+
 static inline int atomic_add_return(int v, volatile int *ptr)
 {
 	int retval = v;
 
-	asm volatile("xaddl %0, %1"
+	asm volatile(LOCK_PREFIX "xaddl %0, %1"
 		     : "+r"(retval), "+m"(*ptr)
 		     :
 		     : "memory", "cc");
@@ -128,6 +303,170 @@ static inline int atomic_add_return(int v, volatile int *ptr)
 	return retval + v;
 }
 
+static inline int atomic_sub_return(int v, volatile int *ptr)
+{
+	return atomic_add_return(-v, ptr);
+}
+
+static inline void atomic_inc(volatile int *ptr)
+{
+	asm volatile(LOCK_PREFIX "incl %0"
+		     : "+m"(*ptr)
+		     :
+		     : "memory", "cc");
+}
+
+static inline void atomic_dec(volatile int *ptr)
+{
+	asm volatile(LOCK_PREFIX "decl %0"
+		     : "+m"(*ptr)
+		     :
+		     : "memory", "cc");
+}
+
+/* Returns true if the result is zero. */
+static inline bool atomic_dec_and_test(volatile int *ptr)
+{
+	unsigned char zero;
+
+	asm volatile(LOCK_PREFIX "decl %0\n\t"
+		     "sete %1"
+		     : "+m"(*ptr), "=qm"(zero)
+		     :
+		     : "memory", "cc");
+
+	return zero;
+}
+
+static inline unsigned long cmpxchg(volatile unsigned long *ptr,
+				    unsigned long old, unsigned long new)
+{
+	unsigned long prev;
+
+	asm volatile(LOCK_PREFIX "cmpxchgl %2, %1"
+		     : "=a"(prev), "+m"(*ptr)
+		     : "r"(new), "0"(old)
+		     : "memory", "cc");
+
+	return prev;
+}
+
+static inline uint64_t cmpxchg64(volatile uint64_t *ptr, uint64_t old,
+				 uint64_t new)
+{
+	uint64_t prev;
+
+	asm volatile(LOCK_PREFIX "cmpxchg8b %1"
+		     : "=A"(prev), "+m"(*ptr)
+		     : "b"((uint32_t)new), "c"((uint32_t)(new >> 32)),
+		       "0"(old)
+		     : "memory", "cc");
+
+	return prev;
+}
+
+static inline unsigned long xchg(volatile unsigned long *ptr, unsigned long v)
+{
+	asm volatile("xchgl %0, %1"
+		     : "+r"(v), "+m"(*ptr)
+		     :
+		     : "memory");
+
+	return v;
+}
+
+/* Returns the old value. */
+static inline unsigned long atomic_fetch_add(unsigned long v,
+					     volatile unsigned long *ptr)
+{
+	asm volatile(LOCK_PREFIX "xaddl %0, %1"
+		     : "+r"(v), "+m"(*ptr)
+		     :
+		     : "memory", "cc");
+
+	return v;
+}
+
+/* Returns the old value. */
+static inline unsigned long atomic_fetch_or(unsigned long v,
+					    volatile unsigned long *ptr)
+{
+	unsigned long old, prev = *ptr;
+
+	do {
+		old = prev;
+		prev = cmpxchg(ptr, old, old | v);
+	} while (prev != old);
+
+	return old;
+}
+
+/* Returns the old value. */
+static inline unsigned long atomic_fetch_and(unsigned long v,
+					     volatile unsigned long *ptr)
+{
+	unsigned long old, prev = *ptr;
+
+	do {
+		old = prev;
+		prev = cmpxchg(ptr, old, old & v);
+	} while (prev != old);
+
+	return old;
+}
+
+/* Returns the old value of the bit. */
+static inline bool test_and_set_bit(int nr, volatile unsigned long *ptr)
+{
+	unsigned char old;
+
+	asm volatile(LOCK_PREFIX "btsl %2, %0\n\t"
+		     "setc %1"
+		     : "+m"(*ptr), "=qm"(old)
+		     : "Ir"(nr)
+		     : "memory", "cc");
+
+	return old;
+}
+
+/* Returns the old value of the bit. */
+static inline bool test_and_clear_bit(int nr, volatile unsigned long *ptr)
+{
+	unsigned char old;
+
+	asm volatile(LOCK_PREFIX "btrl %2, %0\n\t"
+		     "setc %1"
+		     : "+m"(*ptr), "=qm"(old)
+		     : "Ir"(nr)
+		     : "memory", "cc");
+
+	return old;
+}
+
+/* Returns the position of the most significant set bit from 1, or 0. */
+static inline int fls(unsigned long x)
+{
+	int r;
+
+	if (!x)
+		return 0;
+	asm("bsrl %1, %0" : "=r"(r) : "rm"(x) : "cc");
+
+	return r + 1;
+}
+
+static inline int fls64(uint64_t x)
+{
+	uint32_t high = x >> 32;
+
+	return high ? fls(high) + 32 : fls(x);
+}
+
+static inline void cpu_relax(void)
+{
+	asm volatile("pause":::"memory");
+}
+
 void arch_early_init(void);
 void arch_init(void);
 void reboot(void);
@@ -25,6 +25,13 @@
 #ifndef GDT_H
 #define GDT_H
 
+#include <config.h>
+
 void gdt_init(void);
 
+#if CONFIG_SMP
+/* Loads the GDT and the %fs segment of the CPU on the CPU. */
+void gdt_init_cpu(unsigned int cpu);
+#endif
+
 #endif  /* GDT_H */
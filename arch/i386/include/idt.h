@@ -27,4 +27,7 @@
 
 void idt_init(void);
 
+/* Loads the IDT on the calling CPU. */
+void idt_load(void);
+
 #endif  /* IDT_H */
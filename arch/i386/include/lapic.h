@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+	LAPIC_TIMER_VECTOR	= 49,
+	LAPIC_SPURIOUS_VECTOR	= 63,  /* the lower 4 bits are 1 on P6 */
+};
+
+/* Sets the physical base from the MADT before lapic_init(). */
+void lapic_set_base(uint32_t base);
+
+/* Enables the local APIC of the calling CPU. Returns false if it has none. */
+bool lapic_init(void);
+
+unsigned int lapic_id(void);
+void lapic_eoi(void);
+void lapic_send_ipi(unsigned int apic_id, unsigned int vector);
+void lapic_send_init(unsigned int apic_id);
+void lapic_send_startup(unsigned int apic_id, uint32_t addr);
+
+/*
+ * Registers the timer of the boot CPU as the clock event device, in the
+ * TSC-deadline mode if there is one.
+ */
+void lapic_timer_init(void);
+
+#endif  /* LAPIC_H */
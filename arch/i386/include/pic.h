@@ -25,7 +25,12 @@
 #ifndef PIC_H
 #define PIC_H
 
+#include <irq_chip.h>
+
+extern struct irq_chip pic_irq_chip;
+
 void pic_init(void);
+void pic_mask_all(void);
 void pic_ack(unsigned int irq);
 void pic_enable(unsigned int irq);
 void pic_disable(unsigned int irq);
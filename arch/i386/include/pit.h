@@ -25,6 +25,13 @@
 #ifndef PIT_H
 #define PIT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void pit_init();
 
+/* Returns the frequency in kHz of the counter read. */
+uint32_t pit_calibrate_khz(uint64_t (*read)(void));
+bool pit_clocksource_in_use(void);
+
 #endif  /* PIT_H */
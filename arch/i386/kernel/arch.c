@@ -26,6 +26,9 @@
 #include <text_buffer.h>
 #include <gdt.h>
 #include <pit.h>
+#include <tsc.h>
+#include <lapic.h>
+#include <acpi_pm.h>
 #include <cmos.h>
 #include <keyboard.h>
 #include <pthread.h>
@@ -52,6 +55,9 @@ void arch_init(void)
 	gdt_init();
 	interrupt_init();
 	pit_init();
+	acpi_pm_init();
+	tsc_init();
+	lapic_timer_init();
 	cmos_init();
 	keyboard_init();
 #if CONFIG_SWI
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <arch.h>
 #include <stringify.h>
+#include <smp.h>
 
 struct gd {
 	uint16_t	limit_low;
@@ -48,7 +49,11 @@ struct gd {
 	uint8_t		base_addr_high;
 } __attribute__((aligned(8)));
 
-static struct gd gdt[5];
+enum {
+	GDT_PERCPU	= 5,  /* the %fs segments of the CPUs */
+};
+
+static struct gd gdt[GDT_PERCPU + (CONFIG_SMP ? NR_CPUS : 0)];
 
 static const struct {
 	uint16_t	limit;
@@ -130,13 +135,35 @@ static inline void lgdt(void)
 		     : "eax", "memory");
 }
 
+#if CONFIG_SMP
+void gdt_init_cpu(unsigned int cpu)
+{
+	lgdt();
+	asm volatile("mov %0, %%fs"
+		     :
+		     : "r"((GDT_PERCPU + cpu) << 3)
+		     : "memory");
+}
+#endif
+
 void gdt_init(void)
 {
+#if CONFIG_SMP
+	unsigned int cpu;
+#endif
+
 	gd_zero(&gdt[0]);
 	gd_set_code(&gdt[1], 0, 0, 0xffffffff);
 	gd_set_data(&gdt[2], 0, 0, 0xffffffff);
 	gd_set_code(&gdt[3], 3, 0, 0xffffffff);
 	gd_set_data(&gdt[4], 3, 0, 0xffffffff);
-
+#if CONFIG_SMP
+	for (cpu = 0; cpu < NR_CPUS; ++cpu) {
+		gd_set_data(&gdt[GDT_PERCPU + cpu], 0, (uint32_t)&cpus[cpu],
+			    sizeof(struct cpu) - 1);
+	}
+	gdt_init_cpu(0);
+#else
 	lgdt();
+#endif
 }
@@ -87,6 +87,14 @@ static inline void setup_isr(int irq, void (*addr)(void), uint8_t privilege,
 	id_set(idt + irq, addr, privilege, type);
 }
 
+void idt_load(void)
+{
+	asm volatile("lidt %0"
+		     :
+		     : "m"(idt_ptr)
+		     : "memory");
+}
+
 void idt_init(void)
 {
 	size_t i;
@@ -98,8 +106,5 @@ void idt_init(void)
 			setup_isr(i, isr[i], 0, ID_TYPE_INTERRUPT_GATE);
 	}
 
-	asm volatile("lidt %0"
-		     :
-		     : "m"(idt_ptr)
-		     : "memory");
+	idt_load();
 }
@@ -27,10 +27,15 @@
 #include <text_buffer.h>
 #include <stdio.h>
 #include <pic.h>
+#include <ioapic.h>
 #include <idt.h>
+#include <timer.h>
+#include <idle.h>
 
 static interrupt_handler_t *interrupt_handler[IRQ_MAX + 1];
 
+struct irq_chip *irq_chip = &pic_irq_chip;
+
 static void interrupt_default_handler(struct interrupt_context *ctx)
 {
 	text_buffer_init();
@@ -70,13 +75,35 @@ interrupt_handler_t *interrupt_register(unsigned int irq,
 	return old_handler;
 }
 
-void interrupt_dispatch(struct interrupt_context *ctx)
+/*
+ * Returns false if a softirq was interrupted, which must be returned to
+ * without switching the threads.
+ */
+bool interrupt_dispatch(struct interrupt_context *ctx)
 {
+	bool nested;
+
+#if CONFIG_SMP
+	if (ctx->eflags & CPU_FLAG_IF)
+		big_lock_acquire();
+#endif
+	nested = in_softirq;
 	in_irq = true;
+	cpu_idle_exit();
 	interrupt_handler[ctx->irq](ctx);
-	in_irq = false;
 	if (ctx->irq >= 32)
-		pic_ack(ctx->irq);
+		irq_chip->ack(ctx->irq);
+	if (nested)
+		return false;
+	/*
+	 * Not on a trap taken with the interrupts disabled, e.g. the int of
+	 * arch_context_switch(), whose caller still holds the lock.
+	 */
+	if (ctx->eflags & CPU_FLAG_IF)
+		do_softirq();
+	in_irq = false;
+
+	return true;
 }
 
 void interrupt_init(void)
@@ -87,4 +114,10 @@ void interrupt_init(void)
 		interrupt_handler[i] = interrupt_default_handler;
 	idt_init();
 	pic_init();
+	/* The I/O APIC takes over if there is one. */
+	if (ioapic_init()) {
+		pic_mask_all();
+		irq_chip = &ioapic_irq_chip;
+	}
+	printf("Interrupt controller: %s\n", irq_chip->name);
 }
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <smp.h>
+#include <smpboot.h>
+#include <lapic.h>
+#include <acpi.h>
+#include <gdt.h>
+#include <idt.h>
+#include <interrupt.h>
+#include <timer.h>
+#include <stdio.h>
+#include <string.h>
+#include <kernel.h>
+#include <arch.h>
+
+enum {
+	IRQ_RESCHEDULE		= 48,
+};
+
+enum {
+	SMP_INIT_DELAY_US	= 10000,
+	SMP_STARTUP_DELAY_US	= 200,
+	SMP_BOOT_TIMEOUT_US	= 100000,
+};
+
+static unsigned long smp_ap_stacks[NR_CPUS - 1]
+				  [CONFIG_IDLE_STACK_SIZE / sizeof(long)];
+
+/* The handshake with the CPU being started, see trampoline.S. */
+unsigned long smp_ap_stack;
+static volatile unsigned int smp_ap_cpu;
+static volatile bool smp_ap_started;
+
+void smp_ap_start(void) __attribute__((noreturn));
+
+void smp_ap_start(void)
+{
+	unsigned int cpu = smp_ap_cpu;
+
+	gdt_init_cpu(cpu);
+	idt_load();
+	lapic_init();
+	barrier();
+	smp_ap_started = true;
+	smp_cpu_start(cpu, smp_ap_stacks[cpu - 1]);
+}
+
+/* The interrupts are disabled, and the clocksource is all there is. */
+static void smp_delay_us(unsigned long us)
+{
+	uint64_t end = timekeeping_ns() + (uint64_t)us * NSECS_PER_USEC;
+
+	while (timekeeping_ns() < end)
+		cpu_relax();
+}
+
+static bool smp_boot_cpu(unsigned int cpu, unsigned int apic_id)
+{
+	unsigned long *stack = smp_ap_stacks[cpu - 1];
+	unsigned long timeout;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(smp_ap_stacks[0]); ++i)
+		stack[i] = STACK_FILL;
+	smp_ap_stack = (unsigned long)(stack + ARRAY_SIZE(smp_ap_stacks[0]));
+	smp_ap_cpu = cpu;
+	smp_ap_started = false;
+	cpus[cpu].arch_id = apic_id;
+	mb();
+
+	/* INIT-SIPI-SIPI */
+	lapic_send_init(apic_id);
+	smp_delay_us(SMP_INIT_DELAY_US);
+	lapic_send_startup(apic_id, SMP_TRAMPOLINE_ADDR);
+	smp_delay_us(SMP_STARTUP_DELAY_US);
+	if (!smp_ap_started)
+		lapic_send_startup(apic_id, SMP_TRAMPOLINE_ADDR);
+	for (timeout = SMP_BOOT_TIMEOUT_US; !smp_ap_started && timeout > 0;
+	     timeout -= 100)
+		smp_delay_us(100);
+
+	return smp_ap_started;
+}
+
+static void smp_reschedule_interrupt(struct interrupt_context *ctx)
+{
+	(void)ctx;
+	lapic_eoi();
+}
+
+void smp_send_reschedule(unsigned int cpu)
+{
+	lapic_send_ipi(cpus[cpu].arch_id, IRQ_RESCHEDULE);
+}
+
+/* The processors are found in the MADT of ACPI. */
+void smp_boot(void)
+{
+	const struct acpi_madt *madt;
+	const struct acpi_madt_entry *entry;
+	const struct acpi_madt_lapic *lapic;
+
+	madt = (const struct acpi_madt *)acpi_find_table("APIC");
+	if (!madt)
+		return;
+	lapic_set_base(madt->lapic_addr);
+	if (!lapic_init())
+		return;
+	cpus[0].arch_id = lapic_id();
+	interrupt_register(IRQ_RESCHEDULE, smp_reschedule_interrupt);
+	memcpy((void *)SMP_TRAMPOLINE_ADDR, smp_trampoline_begin,
+	       smp_trampoline_end - smp_trampoline_begin);
+
+	acpi_madt_foreach(madt, entry) {
+		if (entry->type != ACPI_MADT_TYPE_LAPIC)
+			continue;
+		lapic = (const struct acpi_madt_lapic *)entry;
+		if (!(lapic->flags & ACPI_MADT_LAPIC_ENABLED) ||
+		    lapic->apic_id == cpus[0].arch_id)
+			continue;
+		if (nr_cpus >= NR_CPUS) {
+			printf("CPU: APIC %u ignored\n", lapic->apic_id);
+			continue;
+		}
+		if (smp_boot_cpu(nr_cpus, lapic->apic_id))
+			nr_cpus++;
+		else
+			printf("CPU: APIC %u doesn't start\n", lapic->apic_id);
+	}
+	printf("CPUs: %u\n", nr_cpus);
+}
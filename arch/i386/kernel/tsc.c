@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <tsc.h>
+#include <pit.h>
+#include <clocksource.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <arch.h>
+
+enum {
+	CPUID_1_EDX_TSC		= 0x10,
+	CPUID_EXT		= 0x80000000,
+	CPUID_EXT_POWER		= 0x80000007,
+	CPUID_POWER_EDX_ITSC	= 0x100,  /* invariant across the C-states */
+};
+
+uint32_t tsc_khz;
+
+static uint64_t tsc_read(void)
+{
+	return rdtsc();
+}
+
+static struct clocksource tsc_clocksource = {
+	.name	= "tsc",
+	.read	= tsc_read,
+	.mask	= ~0ULL,
+};
+
+void tsc_init(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t khz;
+
+	if (!cpu_has_cpuid())
+		return;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_1_EDX_TSC))
+		return;
+
+	/* The TSC may stop in the idle states, unless it is invariant. */
+	tsc_clocksource.rating = 100;
+	cpuid(CPUID_EXT, &eax, &ebx, &ecx, &edx);
+	if (eax >= CPUID_EXT_POWER) {
+		cpuid(CPUID_EXT_POWER, &eax, &ebx, &ecx, &edx);
+		if (edx & CPUID_POWER_EDX_ITSC)
+			tsc_clocksource.rating = 300;
+	}
+
+	khz = pit_calibrate_khz(tsc_read);
+	if (khz == 0)
+		return;
+	tsc_khz = khz;
+	clocksource_register_khz(&tsc_clocksource, khz);
+}
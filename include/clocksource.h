@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <stdint.h>
+
+/*
+ * The longest period in seconds between two reads, for which the conversion
+ * from cycles to nanoseconds must not overflow. The time is folded far more
+ * often than that.
+ */
+#define CLOCKSOURCE_MAXSEC	10
+
+/* A free running counter, of which the time is kept. */
+struct clocksource {
+	const char	*name;
+	int		rating;  /* the higher the better */
+	uint64_t	(*read)(void);
+	uint64_t	mask;
+	uint32_t	mult;  /* ns = (cycles * mult) >> shift */
+	uint32_t	shift;
+};
+
+extern struct clocksource clocksource_jiffies;
+
+static inline uint64_t clocksource_cyc2ns(const struct clocksource *cs,
+					  uint64_t cycles)
+{
+	return (cycles * cs->mult) >> cs->shift;
+}
+
+void clocks_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from,
+			    uint32_t to, uint32_t maxsec);
+
+/* Set the mult and shift for the frequency, and register the clock source. */
+void clocksource_register_hz(struct clocksource *cs, uint32_t hz);
+void clocksource_register_khz(struct clocksource *cs, uint32_t khz);
+
+/* Switches the time keeping to cs, if its rating is the best so far. */
+void clocksource_register(struct clocksource *cs);
+
+#endif  /* CLOCKSOURCE_H */
@@ -29,6 +29,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <arch.h>
+#include <smp.h>
 
 #include <sys/queue.h>
 #include <sys/time.h>
@@ -44,6 +45,8 @@ enum {
 	EFAULT,
 };
 
+#define EWOULDBLOCK EAGAIN
+
 enum pthread_state {
 	PTHREAD_STATE_NONE,
 	PTHREAD_STATE_INIT,
@@ -57,6 +60,17 @@ enum {
 };
 
 struct pthread_mutex;
+struct wait;
+
+/* The release points and statistics of a periodic thread, in ns. */
+struct pthread_period {
+	uint64_t	period;  /* 0 if the thread isn't periodic */
+	uint64_t	next;  /* the next release in CLOCK_MONOTONIC */
+	unsigned long	releases;
+	unsigned long	overruns;  /* the releases missed */
+	uint64_t	jitter_max;  /* the latest wake-up after a release */
+	uint64_t	jitter_sum;
+};
 
 TAILQ_HEAD(pthread_mutex_queue, pthread_mutex);
 
@@ -73,15 +87,32 @@ struct pthread {
 	uint8_t				timeslice;
 #endif
 	uint8_t				flags;
+#if CONFIG_SMP
+	uint8_t				cpu;  /* the run queue */
+	unsigned long			affinity;  /* the CPUs allowed */
+#endif
 	char				name[PTHREAD_NAME_SIZE];
 	struct pthread			*waiter;
 	int				error_code;
-	struct timeval			stime;
+	/* accounted on the context switches, in CLOCK_MONOTONIC ns */
+	uint64_t			runtime;
+	uint64_t			wait_time;  /* runnable but not running */
+	uint64_t			exec_start;
+	uint64_t			wait_start;
+	unsigned long			nvcsw;  /* voluntary context switches */
+	unsigned long			nivcsw;  /* involuntary ones */
+	unsigned long			timer_slack;  /* in ns */
+	struct pthread_period		period;
 	struct pthread_mutex		*sleep_on;
+	struct wait			*sleep_wait;
 	struct pthread_mutex_queue	mutex_queue;
 };
 
+#if CONFIG_SMP
+#define pthread_current	(this_cpu->current)
+#else
 extern struct pthread *pthread_current;
+#endif
 
 #define errno (pthread_current->error_code)
 
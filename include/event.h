@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* The options of event_timedwait(). */
+enum {
+	EVENT_WAIT_ANY	= 0x00,
+	EVENT_WAIT_ALL	= 0x01,
+	EVENT_CLEAR	= 0x02,  /* consume the flags waited for */
+};
+
+/*
+ * An event group is a word of flags, which threads wait on with a mask. The
+ * flags can be set from the interrupt handlers.
+ */
+struct event {
+	uint32_t		flags;
+	struct wait_queue	wq;
+};
+
+typedef struct event event_t;
+
+int event_init(event_t *event, uint32_t flags);
+int event_destroy(event_t *event);
+int event_timedwait(event_t *event, uint32_t mask, int options,
+		    uint32_t *flags, const struct timespec *abstime);
+uint32_t event_set(event_t *event, uint32_t mask);
+uint32_t event_clear(event_t *event, uint32_t mask);
+uint32_t event_get(event_t *event);
+
+static inline int event_wait(event_t *event, uint32_t mask, int options,
+			     uint32_t *flags)
+{
+	return event_timedwait(event, mask, options, flags, NULL);
+}
+
+#endif  /* EVENT_H */
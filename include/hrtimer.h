@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * A timer which expires at an absolute CLOCK_MONOTONIC time in ns. The
+ * function runs in the hard interrupt, so it should do no more than waking up
+ * a thread.
+ */
+struct hrtimer {
+	uint64_t	expires;
+	/* the links in the pairing heap of the pending timers */
+	struct hrtimer	*child;
+	struct hrtimer	*sibling;
+	struct hrtimer	*prev;  /* the left sibling, or the parent */
+	bool		queued;
+	void		(*func)(struct hrtimer *timer);
+};
+
+static inline void hrtimer_init(struct hrtimer *timer,
+				void (*func)(struct hrtimer *timer))
+{
+	timer->queued = false;
+	timer->func = func;
+}
+
+/*
+ * (Re)starts the timer to expire at the absolute CLOCK_MONOTONIC ns, or up to
+ * slack ns later, so the timers expiring close to each other are rounded to
+ * the same time and run in one batch.
+ */
+void hrtimer_start_range(struct hrtimer *timer, uint64_t expires,
+			 uint64_t slack);
+
+static inline void hrtimer_start(struct hrtimer *timer, uint64_t expires)
+{
+	hrtimer_start_range(timer, expires, 0);
+}
+
+void hrtimer_cancel(struct hrtimer *timer);
+
+/*
+ * Sleeps until woken up, or until the absolute CLOCK_MONOTONIC time expires,
+ * which may be deferred by up to slack ns, or by the timer slack of the thread
+ * with schedule_hrtimeout(). The state of the current thread must have been
+ * set to PTHREAD_STATE_SLEEPING. Returns the ns left, which is not positive if
+ * it timed out.
+ */
+int64_t schedule_hrtimeout_range(uint64_t expires, uint64_t slack);
+int64_t schedule_hrtimeout(uint64_t expires);
+
+/*
+ * Moves expires forward by whole intervals until it is after now. Returns the
+ * intervals added.
+ */
+uint64_t hrtimer_forward(uint64_t *expires, uint64_t now, uint64_t interval);
+
+/* Used by the clock event code with the interrupts disabled. */
+void hrtimer_run(uint64_t now);
+uint64_t hrtimer_next(void);
+
+#endif  /* HRTIMER_H */
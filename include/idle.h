@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+enum {
+	IDLE_HALT,
+	IDLE_MWAIT,  /* monitor/mwait, if CPUID reports it */
+	IDLE_MODE_NUM,
+};
+
+/* The time is in CLOCK_MONOTONIC ns. */
+struct idle_stats {
+	unsigned long	poll_entries;
+	unsigned long	poll_hits;  /* the polls ended by a wakeup */
+	uint64_t	poll_ns;
+	unsigned long	entries[IDLE_MODE_NUM];
+	uint64_t	residency_ns[IDLE_MODE_NUM];
+};
+
+/*
+ * The loop of the idle thread. Before sleeping in the selected mode, it spins
+ * for up to the poll window, so a wakeup in the window doesn't pay the exit
+ * latency of the sleep.
+ */
+void cpu_idle(void) __attribute__((noreturn));
+
+/* Called on the interrupts with the interrupts disabled. */
+void cpu_idle_exit(void);
+
+int idle_set_mode(int mode);
+int idle_get_mode(void);
+void idle_set_poll_ns(unsigned long ns);
+unsigned long idle_get_poll_ns(void);
+void idle_get_stats(struct idle_stats *stats);
+
+#endif  /* IDLE_H */
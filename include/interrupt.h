@@ -27,12 +27,35 @@
 
 #include <stdbool.h>
 #include <arch.h>
+#include <smp.h>
 
+#if CONFIG_SMP
+#define in_irq		(this_cpu->irq)
+#define in_softirq	(this_cpu->softirq)
+#else
 extern bool in_irq;
+extern bool in_softirq;
+#endif
 
 typedef void interrupt_handler_t(struct interrupt_context *ctx);
 
 interrupt_handler_t *interrupt_register(unsigned int irq,
 					interrupt_handler_t *handler);
 
+/*
+ * The softirqs run the deferred work of the interrupt handlers on the way out
+ * of the interrupts with the interrupts enabled. They don't nest, and they
+ * can't sleep.
+ */
+enum {
+	SOFTIRQ_TIMER,
+	SOFTIRQ_MAX
+};
+
+/* Marks the softirq pending. */
+void raise_softirq(unsigned int nr);
+
+/* Called with the interrupts disabled, and returns with them disabled. */
+void do_softirq(void);
+
 #endif  /* INTERRUPT_H */
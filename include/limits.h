@@ -33,8 +33,11 @@
 
 #define LINE_MAX CONFIG_LINE_MAX
 
+#define INT_MAX   0x7fffffff
 #define ULONG_MAX 0xffffffffUL
 #define LONG_MAX  0x7fffffffL
 #define LONG_MIN (-LONG_MAX - 1)
 
+#define DELAYTIMER_MAX INT_MAX
+
 #endif  /* LIMITS_H */
@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <sched.h>
+#include <spinlock.h>
 #include <time.h>
 
 enum {
@@ -45,12 +46,69 @@ TAILQ_HEAD(pthread_queue, pthread);
 
 struct wait {
 	pthread_t		thread;
+	uint8_t			priority;
 	TAILQ_ENTRY(, wait)	link;
 };
 
-TAILQ_HEAD(wait_queue, wait);
+TAILQ_HEAD(wait_list, wait);
 
+/* Waiters are bucketed by priority, and are FIFO within the same bucket. */
+struct wait_queue {
+	struct wait_list	level[SCHED_RR_PRIORITY_MAX + 1];
+	int			bitmap;
+};
+
+/* NULL if the scheduler has to run on the way out of the interrupt. */
+#if CONFIG_SMP
+#define pthread_next	(this_cpu->next)
+#else
 extern pthread_t	pthread_next;
+#endif
+
+/*
+ * While the preempt count isn't 0, the current thread isn't switched out, and
+ * the rescheduling is deferred until preempt_enable(), so the data touched by
+ * the threads only can be protected without masking the interrupts. The
+ * thread can't sleep meanwhile. The count is per CPU, but it is 0 whenever the
+ * thread is switched out, so it doesn't matter where the thread resumes.
+ */
+#if CONFIG_SMP
+#define preempt_count	(this_cpu->preempt)
+#else
+extern volatile unsigned long preempt_count;
+#endif
+
+static inline void preempt_disable(void)
+{
+	preempt_count++;
+	barrier();
+}
+
+void preempt_enable(void);
+
+/*
+ * Protects the data touched by the threads only: disabling the preemption is
+ * enough on a uniprocessor, and the lock keeps the other CPUs out.
+ */
+static inline void preempt_lock(spinlock_t *lock)
+{
+	preempt_disable();
+#if CONFIG_SMP
+	spin_lock(lock);
+#else
+	(void)lock;
+#endif
+}
+
+static inline void preempt_unlock(spinlock_t *lock)
+{
+#if CONFIG_SMP
+	spin_unlock(lock);
+#else
+	(void)lock;
+#endif
+	preempt_enable();
+}
 
 static inline int pthread_equal(pthread_t t1, pthread_t t2)
 {
@@ -61,8 +119,35 @@ void schedule(void);
 
 void wake_up(pthread_t th);
 
+/*
+ * Returns true if the scheduler has to run, or another thread than the idle
+ * one is queued on the CPU. Lockless, for the idle thread to poll.
+ */
+bool pthread_resched_pending(void);
+
 void pthread_init(void);
 
+#if CONFIG_SMP
+/* Sets up the idle thread of the calling CPU, which runs on stack_addr. */
+void pthread_init_cpu(unsigned int cpu, void *stack_addr);
+#endif
+
+#if CONFIG_RR
+/* Charges n ticks to the timeslices of the running threads. */
+void pthread_tick(unsigned long n);
+
+#if CONFIG_SMP
+/* Returns true if a thread on the other CPUs needs the ticks. */
+bool pthread_tick_needed(void);
+#endif
+#endif
+
+/* Returns the CPU time of the thread in ns, including the current run. */
+uint64_t pthread_cputime(pthread_t thread);
+
+/* Returns the thread of the CPU time clock, or NULL if it is invalid. */
+pthread_t pthread_cpuclock_thread(clockid_t clock_id);
+
 struct pthread_attr {
 	void	*stack_addr;
 	size_t	stack_size;
@@ -143,13 +228,66 @@ int pthread_getname_np(pthread_t thread, char *buf, size_t size);
 
 int pthread_setname_np(pthread_t thread, const char *name);
 
+int pthread_getcpuclockid(pthread_t thread, clockid_t *clock_id);
+
+/*
+ * The thread only runs on the CPUs in the set, which is inherited by the new
+ * threads.
+ */
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize,
+			   const cpu_set_t *cpuset);
+
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize,
+			   cpu_set_t *cpuset);
+
+/*
+ * The timer slack is how many ns the sleeps of the thread may be deferred to
+ * be coalesced with the other timers. It is inherited by the new threads.
+ */
+int pthread_gettimerslack_np(pthread_t thread, unsigned long *slack);
+
+int pthread_settimerslack_np(pthread_t thread, unsigned long slack);
+
+/*
+ * Makes the thread release every period from the absolute CLOCK_MONOTONIC
+ * time start, or from now if start is NULL. A zero period makes it aperiodic
+ * again.
+ */
+int pthread_make_periodic_np(pthread_t thread, const struct timespec *start,
+			     const struct timespec *period);
+
+/*
+ * Sleeps until the next release of the current thread. Returns ETIMEDOUT with
+ * the releases missed in overruns if it is late.
+ */
+int pthread_wait_period_np(unsigned long *overruns);
+
+int pthread_getperiod_np(pthread_t thread, struct pthread_period *period);
+
+/*
+ * PTHREAD_MUTEX_HANDOFF_NP passes the ownership to the top waiter on unlock,
+ * so it can't be stolen before the waiter gets to run.
+ */
 enum {
 	PTHREAD_MUTEX_FAST_NP,
-	PTHREAD_MUTEX_RECURSIVE_NP
+	PTHREAD_MUTEX_RECURSIVE_NP,
+	PTHREAD_MUTEX_HANDOFF_NP
+};
+
+/*
+ * PTHREAD_PRIO_INHERIT is the default, so the mutexes keep boosting their
+ * owners to the priority of the top waiter unless told otherwise.
+ */
+enum {
+	PTHREAD_PRIO_NONE,
+	PTHREAD_PRIO_INHERIT,
+	PTHREAD_PRIO_PROTECT
 };
 
 struct pthread_mutexattr {
-	int type;
+	int	type;
+	int	protocol;
+	int	prioceiling;
 };
 
 typedef struct pthread_mutexattr pthread_mutexattr_t;
@@ -157,6 +295,8 @@ typedef struct pthread_mutexattr pthread_mutexattr_t;
 static inline int pthread_mutexattr_init(pthread_mutexattr_t *attr)
 {
 	attr->type = PTHREAD_MUTEX_FAST_NP;
+	attr->protocol = PTHREAD_PRIO_INHERIT;
+	attr->prioceiling = SCHED_RR_PRIORITY_MAX;
 
 	return 0;
 }
@@ -184,12 +324,57 @@ static inline int pthread_mutexattr_gettype(pthread_mutexattr_t *attr,
 	return 0;
 }
 
+static inline int pthread_mutexattr_setprotocol(pthread_mutexattr_t *attr,
+						int protocol)
+{
+	switch (protocol) {
+	case PTHREAD_PRIO_NONE:
+	case PTHREAD_PRIO_INHERIT:
+	case PTHREAD_PRIO_PROTECT:
+		attr->protocol = protocol;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+static inline int pthread_mutexattr_getprotocol(
+		const pthread_mutexattr_t *attr, int *protocol)
+{
+	*protocol = attr->protocol;
+
+	return 0;
+}
+
+static inline int pthread_mutexattr_setprioceiling(pthread_mutexattr_t *attr,
+						   int prioceiling)
+{
+	if (prioceiling < SCHED_RR_PRIORITY_MIN ||
+	    prioceiling > SCHED_RR_PRIORITY_MAX)
+		return EINVAL;
+	attr->prioceiling = prioceiling;
+
+	return 0;
+}
+
+static inline int pthread_mutexattr_getprioceiling(
+		const pthread_mutexattr_t *attr, int *prioceiling)
+{
+	*prioceiling = attr->prioceiling;
+
+	return 0;
+}
+
 struct pthread_mutex {
-	volatile int			lock;
+	volatile unsigned long		lock;
 	struct wait_queue		wq;
 	int				type;
-	pthread_t			owner;
 	int				recursive_count;
+	int				protocol;
+	uint8_t				prioceiling;
+	uint8_t				priority;  /* conferred on the owner */
 	TAILQ_ENTRY(, pthread_mutex)	link;
 };
 
@@ -198,8 +383,14 @@ typedef struct pthread_mutex pthread_mutex_t;
 int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
 int pthread_mutex_destroy(pthread_mutex_t *mutex);
 int pthread_mutex_lock(pthread_mutex_t *mutex);
+int pthread_mutex_timedlock(pthread_mutex_t *mutex,
+			    const struct timespec *abstime);
 int pthread_mutex_trylock(pthread_mutex_t *mutex);
 int pthread_mutex_unlock(pthread_mutex_t *mutex);
+int pthread_mutex_getprioceiling(const pthread_mutex_t *mutex,
+				 int *prioceiling);
+int pthread_mutex_setprioceiling(pthread_mutex_t *mutex, int prioceiling,
+				 int *old_ceiling);
 
 struct pthread_condattr {
 };
@@ -221,7 +412,8 @@ static inline int pthread_condattr_destroy(pthread_condattr_t *attr)
 }
 
 struct pthread_cond {
-	struct wait_queue wq;
+	struct wait_queue	wq;
+	pthread_mutex_t		*mutex;  /* used by the waiters */
 };
 
 typedef struct pthread_cond pthread_cond_t;
@@ -238,6 +430,168 @@ static inline int pthread_cond_wait(pthread_cond_t *cond,
 	return pthread_cond_timedwait(cond, mutex, NULL);
 }
 
+enum {
+	PTHREAD_RWLOCK_PREFER_READER_NP,
+	PTHREAD_RWLOCK_PREFER_WRITER_NP,
+	PTHREAD_RWLOCK_DEFAULT_NP = PTHREAD_RWLOCK_PREFER_WRITER_NP
+};
+
+struct pthread_rwlockattr {
+	int kind;
+};
+
+typedef struct pthread_rwlockattr pthread_rwlockattr_t;
+
+static inline int pthread_rwlockattr_init(pthread_rwlockattr_t *attr)
+{
+	attr->kind = PTHREAD_RWLOCK_DEFAULT_NP;
+
+	return 0;
+}
+
+static inline int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr)
+{
+	(void)attr;
+
+	return 0;
+}
+
+static inline int pthread_rwlockattr_setkind_np(pthread_rwlockattr_t *attr,
+						int pref)
+{
+	switch (pref) {
+	case PTHREAD_RWLOCK_PREFER_READER_NP:
+	case PTHREAD_RWLOCK_PREFER_WRITER_NP:
+		attr->kind = pref;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+static inline int pthread_rwlockattr_getkind_np(const pthread_rwlockattr_t *attr,
+						int *pref)
+{
+	*pref = attr->kind;
+
+	return 0;
+}
+
+/*
+ * The embedded mutex is never locked as a mutex. It records the writer as its
+ * owner and queues all the waiters, so the blocked readers and writers boost
+ * the writer through the same priority inheritance as the mutex waiters.
+ */
+struct pthread_rwlock {
+	struct pthread_mutex	mutex;
+	int			kind;
+	int			readers;
+	int			readers_waiting;
+	int			writers_waiting;
+};
+
+typedef struct pthread_rwlock pthread_rwlock_t;
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock,
+			const pthread_rwlockattr_t *attr);
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock);
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock);
+
+enum {
+	PTHREAD_BARRIER_SERIAL_THREAD = -1
+};
+
+struct pthread_barrierattr {
+};
+
+typedef struct pthread_barrierattr pthread_barrierattr_t;
+
+static inline int pthread_barrierattr_init(pthread_barrierattr_t *attr)
+{
+	(void)attr;
+
+	return 0;
+}
+
+static inline int pthread_barrierattr_destroy(pthread_barrierattr_t *attr)
+{
+	(void)attr;
+
+	return 0;
+}
+
+struct pthread_barrier {
+	unsigned int		count;
+	unsigned int		waiting;
+	struct wait_list	wl;
+};
+
+typedef struct pthread_barrier pthread_barrier_t;
+
+int pthread_barrier_init(pthread_barrier_t *barrier,
+			 const pthread_barrierattr_t *attr, unsigned int count);
+int pthread_barrier_destroy(pthread_barrier_t *barrier);
+int pthread_barrier_wait(pthread_barrier_t *barrier);
+
+/*
+ * The interrupts are disabled while a spin lock is held, so on a single CPU
+ * the holder can't be preempted by a spinning thread.
+ */
+struct pthread_spinlock {
+	spinlock_t	lock;
+	unsigned long	flags;
+};
+
+typedef struct pthread_spinlock pthread_spinlock_t;
+
+static inline int pthread_spin_init(pthread_spinlock_t *lock, int pshared)
+{
+	(void)pshared;
+	spin_lock_init(&lock->lock);
+
+	return 0;
+}
+
+static inline int pthread_spin_destroy(pthread_spinlock_t *lock)
+{
+	(void)lock;
+
+	return 0;
+}
+
+static inline int pthread_spin_lock(pthread_spinlock_t *lock)
+{
+	lock->flags = spin_lock_irqsave(&lock->lock);
+
+	return 0;
+}
+
+static inline int pthread_spin_trylock(pthread_spinlock_t *lock)
+{
+	unsigned long flags = interrupt_disable();
+
+	if (!spin_trylock(&lock->lock)) {
+		interrupt_enable(flags);
+		return EBUSY;
+	}
+	lock->flags = flags;
+
+	return 0;
+}
+
+static inline int pthread_spin_unlock(pthread_spinlock_t *lock)
+{
+	spin_unlock_irqrestore(&lock->lock, lock->flags);
+
+	return 0;
+}
+
 void pthread_foreach(void (*callback)(pthread_t));
 
 void arch_pthread_init(pthread_t th, void (*wrapper)(void *(*)(void *), void *),
@@ -42,6 +42,20 @@ struct sched_param {
 	int sched_priority;
 };
 
+/* A set of CPUs. */
+typedef struct {
+	unsigned long	bits;
+} cpu_set_t;
+
+#define CPU_SETSIZE		(sizeof(unsigned long) * 8)
+#define CPU_ZERO(set)		((set)->bits = 0)
+#define CPU_SET(cpu, set)	((set)->bits |= 1UL << (cpu))
+#define CPU_CLR(cpu, set)	((set)->bits &= ~(1UL << (cpu)))
+#define CPU_ISSET(cpu, set)	(((set)->bits >> (cpu)) & 1)
+
+/* Returns the CPU the calling thread is running on. */
+int sched_getcpu(void);
+
 static inline int sched_get_priority_min(int policy)
 {
 	if (policy != SCHED_RR) {
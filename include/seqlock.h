@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdbool.h>
+#include <arch.h>
+#include <spinlock.h>
+
+/*
+ * A sequence counter is odd while the data it protects is being written, and
+ * the readers retry if it has changed under them, so they never block the
+ * writers. The writers must be serialized, and must not be interrupted by the
+ * readers, or the readers spin forever.
+ */
+struct seqcount {
+	volatile unsigned long	sequence;
+};
+
+typedef struct seqcount seqcount_t;
+
+#define SEQCOUNT_INITIALIZER	{ 0 }
+
+static inline void seqcount_init(seqcount_t *s)
+{
+	s->sequence = 0;
+}
+
+static inline unsigned long read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned long seq;
+
+	while ((seq = s->sequence) & 1)
+		cpu_relax();
+	smp_rmb();
+
+	return seq;
+}
+
+static inline bool read_seqcount_retry(const seqcount_t *s, unsigned long seq)
+{
+	smp_rmb();
+
+	return s->sequence != seq;
+}
+
+static inline void write_seqcount_begin(seqcount_t *s)
+{
+	s->sequence++;
+	smp_wmb();
+}
+
+static inline void write_seqcount_end(seqcount_t *s)
+{
+	smp_wmb();
+	s->sequence++;
+}
+
+/* A sequence counter with a spinlock to serialize the writers. */
+struct seqlock {
+	seqcount_t	seqcount;
+	spinlock_t	lock;
+};
+
+typedef struct seqlock seqlock_t;
+
+#define SEQLOCK_INITIALIZER	{ SEQCOUNT_INITIALIZER, SPINLOCK_INITIALIZER }
+
+static inline void seqlock_init(seqlock_t *sl)
+{
+	seqcount_init(&sl->seqcount);
+	spin_lock_init(&sl->lock);
+}
+
+static inline unsigned long read_seqbegin(const seqlock_t *sl)
+{
+	return read_seqcount_begin(&sl->seqcount);
+}
+
+static inline bool read_seqretry(const seqlock_t *sl, unsigned long seq)
+{
+	return read_seqcount_retry(&sl->seqcount, seq);
+}
+
+static inline unsigned long write_seqlock_irqsave(seqlock_t *sl)
+{
+	unsigned long flags = spin_lock_irqsave(&sl->lock);
+
+	write_seqcount_begin(&sl->seqcount);
+
+	return flags;
+}
+
+static inline void write_sequnlock_irqrestore(seqlock_t *sl,
+					      unsigned long flags)
+{
+	write_seqcount_end(&sl->seqcount);
+	spin_unlock_irqrestore(&sl->lock, flags);
+}
+
+#endif  /* SEQLOCK_H */
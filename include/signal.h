@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+/* There are no signals, so only SIGEV_NONE and SIGEV_THREAD are supported. */
+enum {
+	SIGEV_NONE,
+	SIGEV_THREAD
+};
+
+union sigval {
+	int	sival_int;
+	void	*sival_ptr;
+};
+
+struct pthread_attr;
+
+struct sigevent {
+	int			sigev_notify;
+	union sigval		sigev_value;
+	void			(*sigev_notify_function)(union sigval value);
+	/* ignored, the notifications are run on the timer service thread */
+	struct pthread_attr	*sigev_notify_attributes;
+};
+
+#endif  /* SIGNAL_H */
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <config.h>
+
+#ifndef CONFIG_SMP
+#define CONFIG_SMP 0
+#endif
+
+#if CONFIG_SMP
+#ifndef CONFIG_NR_CPUS
+#define CONFIG_NR_CPUS 8
+#endif
+#if CONFIG_NR_CPUS > 32
+#error "CONFIG_NR_CPUS must fit in the affinity mask"
+#endif
+#if CONFIG_USERSPACE
+#error "CONFIG_SMP keeps the per-CPU data in %fs, which the user space owns"
+#endif
+#define NR_CPUS CONFIG_NR_CPUS
+#else
+#define NR_CPUS 1
+#endif
+
+/* The offsets in struct cpu used by isr.S. */
+#define CPU_CURRENT	4
+#define CPU_NEXT	8
+#define CPU_PREEMPT	12
+
+#ifndef __ASSEMBLY__
+#include <stdbool.h>
+#include <stdint.h>
+
+struct pthread;
+
+/*
+ * The data of a CPU, which the CPU finds at the base of its %fs segment, so
+ * the single instructions accessing it through this_cpu don't race with the
+ * migrations of the thread.
+ */
+struct cpu {
+	struct cpu		*self;
+	struct pthread		*current;
+	struct pthread		*next;
+	volatile unsigned long	preempt;
+	bool			irq;
+	bool			softirq;
+	volatile bool		online;
+	unsigned int		id;
+	unsigned int		arch_id;  /* the local APIC ID */
+};
+
+#if CONFIG_SMP
+extern struct cpu cpus[NR_CPUS];
+extern unsigned int nr_cpus;
+
+#define this_cpu		((__seg_fs struct cpu *)0)
+#define this_cpu_ptr()		(this_cpu->self)
+#define smp_processor_id()	(this_cpu->id)
+
+/* Called by the boot CPU before arch_init(). */
+void smp_init(void);
+
+/*
+ * Starts the other CPUs. Called by the boot CPU with the interrupts disabled
+ * right before it enables them.
+ */
+void smp_boot(void);
+
+/* Runs the scheduler on the CPU on the way out of an interrupt. */
+void smp_send_reschedule(unsigned int cpu);
+
+/* Called by the other CPUs once their hardware is set up. Never returns. */
+void smp_cpu_start(unsigned int cpu, void *stack_addr)
+	__attribute__((noreturn));
+
+unsigned long cpu_online_mask(void);
+#else
+#define smp_processor_id()	0U
+
+static inline void smp_init(void)
+{
+}
+
+static inline void smp_boot(void)
+{
+}
+
+static inline unsigned long cpu_online_mask(void)
+{
+	return 1;
+}
+#endif
+#endif  /* __ASSEMBLY__ */
+
+#endif  /* SMP_H */
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <arch.h>
+
+/*
+ * A ticket lock: the lower half of the word is the ticket being served, and
+ * the upper half is the next ticket, so the CPUs get the lock in FIFO order.
+ */
+struct spinlock {
+	volatile unsigned long	lock;
+};
+
+typedef struct spinlock spinlock_t;
+
+#define SPINLOCK_INITIALIZER	{ 0 }
+
+enum {
+	SPINLOCK_TICKET_SHIFT	= 16,
+	SPINLOCK_TICKET_MASK	= 0xffff
+};
+
+static inline void spin_lock_init(spinlock_t *lock)
+{
+	lock->lock = 0;
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	unsigned long ticket;
+
+	ticket = atomic_fetch_add(1 << SPINLOCK_TICKET_SHIFT, &lock->lock);
+	ticket = (ticket >> SPINLOCK_TICKET_SHIFT) & SPINLOCK_TICKET_MASK;
+	while ((lock->lock & SPINLOCK_TICKET_MASK) != ticket)
+		cpu_relax();
+	barrier();
+}
+
+static inline bool spin_trylock(spinlock_t *lock)
+{
+	unsigned long old = lock->lock;
+
+	if ((old & SPINLOCK_TICKET_MASK) !=
+	    ((old >> SPINLOCK_TICKET_SHIFT) & SPINLOCK_TICKET_MASK))
+		return false;
+
+	return cmpxchg(&lock->lock, old, old + (1 << SPINLOCK_TICKET_SHIFT)) ==
+	       old;
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+	barrier();
+	/* Only the owner writes the lower half, and it never carries over. */
+	asm volatile(LOCK_PREFIX "incw %0"
+		     : "+m"(lock->lock)
+		     :
+		     : "memory", "cc");
+}
+
+static inline bool spin_is_locked(spinlock_t *lock)
+{
+	unsigned long v = lock->lock;
+
+	return (v & SPINLOCK_TICKET_MASK) !=
+	       ((v >> SPINLOCK_TICKET_SHIFT) & SPINLOCK_TICKET_MASK);
+}
+
+static inline unsigned long spin_lock_irqsave(spinlock_t *lock)
+{
+	unsigned long flags = interrupt_disable();
+
+	spin_lock(lock);
+
+	return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock,
+					  unsigned long flags)
+{
+	spin_unlock(lock);
+	interrupt_enable(flags);
+}
+
+/*
+ * An MCS lock: every CPU spins on its own node, which is queued by the caller,
+ * instead of on the shared word, so a contended lock doesn't bounce a cache
+ * line between all the waiters.
+ */
+struct mcs_node {
+	struct mcs_node * volatile	next;
+	volatile unsigned long		locked;
+};
+
+struct mcs_lock {
+	volatile unsigned long	tail;  /* struct mcs_node * */
+};
+
+typedef struct mcs_lock mcs_lock_t;
+
+#define MCS_LOCK_INITIALIZER	{ 0 }
+
+static inline void mcs_lock_init(mcs_lock_t *lock)
+{
+	lock->tail = 0;
+}
+
+static inline void mcs_lock(mcs_lock_t *lock, struct mcs_node *node)
+{
+	struct mcs_node *prev;
+
+	node->next = NULL;
+	node->locked = 0;
+	prev = (struct mcs_node *)xchg(&lock->tail, (unsigned long)node);
+	if (prev) {
+		prev->next = node;
+		while (!node->locked)
+			cpu_relax();
+	}
+	barrier();
+}
+
+static inline bool mcs_trylock(mcs_lock_t *lock, struct mcs_node *node)
+{
+	node->next = NULL;
+	node->locked = 0;
+
+	return cmpxchg(&lock->tail, 0, (unsigned long)node) == 0;
+}
+
+static inline void mcs_unlock(mcs_lock_t *lock, struct mcs_node *node)
+{
+	barrier();
+	if (!node->next) {
+		if (cmpxchg(&lock->tail, (unsigned long)node, 0) ==
+		    (unsigned long)node)
+			return;
+		/* A successor is linking itself in. */
+		while (!node->next)
+			cpu_relax();
+	}
+	node->next->locked = 1;
+}
+
+static inline unsigned long mcs_lock_irqsave(mcs_lock_t *lock,
+					     struct mcs_node *node)
+{
+	unsigned long flags = interrupt_disable();
+
+	mcs_lock(lock, node);
+
+	return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock,
+					 struct mcs_node *node,
+					 unsigned long flags)
+{
+	mcs_unlock(lock, node);
+	interrupt_enable(flags);
+}
+
+#endif  /* SPINLOCK_H */
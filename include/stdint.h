@@ -35,4 +35,8 @@ typedef unsigned short int uint16_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+#define INT64_MAX	0x7fffffffffffffffLL
+#define UINT32_MAX	0xffffffffU
+#define UINT64_MAX	0xffffffffffffffffULL
+
 #endif  /* STDINT_H */
@@ -60,6 +60,8 @@ do { \
 
 #define TAILQ_FIRST(head) ((head)->first)
 
+#define TAILQ_NEXT(entry, member) ((entry)->member.next)
+
 #define TAILQ_INSERT_HEAD(head, entry, member) \
 do { \
 	(entry)->member.next = (head)->first; \
@@ -79,6 +81,14 @@ do { \
 	(head)->ptail = &(entry)->member.next; \
 } while (0)
 
+#define TAILQ_INSERT_BEFORE(listentry, entry, member) \
+do { \
+	(entry)->member.pprev = (listentry)->member.pprev; \
+	(entry)->member.next = (listentry); \
+	*((listentry)->member.pprev) = (entry); \
+	(listentry)->member.pprev = &(entry)->member.next; \
+} while (0)
+
 #define TAILQ_REMOVE(head, entry, member) \
 do { \
 	if ((entry)->member.next) \
@@ -91,4 +101,54 @@ do { \
 #define TAILQ_FOREACH(it, head, member) \
 for ((it) = (head)->first; (it); (it) = (it)->member.next)
 
+/* A list which can be removed from without its head, but has no tail. */
+#define LIST_HEAD(name, type) \
+struct name { \
+	struct type	*first; \
+}
+
+#define LIST_INIT(head) \
+do { \
+	(head)->first = NULL; \
+} while (0)
+
+#define LIST_ENTRY(name, type) \
+struct name { \
+	struct type	*next; \
+	struct type	**pprev; \
+}
+
+#define LIST_ENTRY_INIT(entry) \
+do { \
+	(entry)->pprev = NULL; \
+} while (0)
+
+#define LIST_ENTRY_EMPTY(entry) ((entry)->pprev == NULL)
+
+#define LIST_EMPTY(head) ((head)->first == NULL)
+
+#define LIST_FIRST(head) ((head)->first)
+
+#define LIST_NEXT(entry, member) ((entry)->member.next)
+
+#define LIST_INSERT_HEAD(head, entry, member) \
+do { \
+	(entry)->member.next = (head)->first; \
+	(entry)->member.pprev = &(head)->first; \
+	if ((head)->first) \
+		(head)->first->member.pprev = &(entry)->member.next; \
+	(head)->first = (entry); \
+} while (0)
+
+#define LIST_REMOVE(entry, member) \
+do { \
+	if ((entry)->member.next) \
+		(entry)->member.next->member.pprev = (entry)->member.pprev; \
+	*((entry)->member.pprev) = (entry)->member.next; \
+	LIST_ENTRY_INIT(&(entry)->member); \
+} while (0)
+
+#define LIST_FOREACH(it, head, member) \
+for ((it) = (head)->first; (it); (it) = (it)->member.next)
+
 #endif  /* SYS_QUEUE_H */
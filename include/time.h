@@ -37,16 +37,26 @@ enum {
 	USECS_PER_MSEC	= 1000,
 	MSECS_PER_SEC	= 1000,
 	USECS_PER_SEC	= USECS_PER_MSEC * MSECS_PER_SEC,
+	NSECS_PER_MSEC	= NSECS_PER_USEC * USECS_PER_MSEC,
 	NSECS_PER_SEC	= NSECS_PER_USEC * USECS_PER_SEC
 };
 
+/*
+ * The negative clock IDs are the CPU time clocks of the threads, returned by
+ * pthread_getcpuclockid().
+ */
 enum clockid {
 	CLOCK_REALTIME,
-	CLOCK_MONOTONIC
+	CLOCK_MONOTONIC,
+	CLOCK_THREAD_CPUTIME_ID
 };
 
 typedef enum clockid clockid_t;
 
+enum {
+	TIMER_ABSTIME	= 0x01
+};
+
 /* It is a simplified version */
 struct tm {
 	int tm_sec;
@@ -63,6 +73,13 @@ struct timespec {
 	long	tv_nsec;
 };
 
+struct itimerspec {
+	struct timespec	it_interval;
+	struct timespec	it_value;
+};
+
+typedef int timer_t;
+
 static inline bool is_leapyear(int year)
 {
 	return (year % 4) == 0 && ((year % 100) != 0 || (year % 400) == 0);
@@ -75,5 +92,18 @@ struct tm *localtime_r(const time_t *timep, struct tm *result);
 void uptime(struct timeval *tv);
 int clock_gettime(clockid_t clk_id, struct timespec *tp);
 int clock_settime(clockid_t clk_id, const struct timespec *tp);
+int clock_nanosleep(clockid_t clk_id, int flags,
+		    const struct timespec *request, struct timespec *remain);
+int nanosleep(const struct timespec *req, struct timespec *rem);
+
+struct sigevent;
+
+int timer_create(clockid_t clk_id, struct sigevent *sevp, timer_t *timerid);
+int timer_delete(timer_t timerid);
+int timer_settime(timer_t timerid, int flags,
+		  const struct itimerspec *new_value,
+		  struct itimerspec *old_value);
+int timer_gettime(timer_t timerid, struct itimerspec *curr_value);
+int timer_getoverrun(timer_t timerid);
 
 #endif  /* TIME_H */
@@ -26,9 +26,14 @@
 #define TIMER_H
 
 #include <config.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <time.h>
+#include <arch.h>
+
+#include <sys/queue.h>
 
 #define time_after(a, b)	((long)((b) - (a)) < 0)
 #define time_before(a, b)	time_after(b, a)
@@ -37,16 +42,42 @@
 #define CONFIG_HZ 100
 #endif
 
-#define TIMER_INVALID_INDEX	((size_t)-1l)
+#ifndef CONFIG_NO_HZ
+#define CONFIG_NO_HZ 0
+#endif
+
+/* The default timer slack of the threads. */
+#ifndef CONFIG_TIMER_SLACK_NS
+#define CONFIG_TIMER_SLACK_NS 50000
+#endif
 
+/* Runs the function in the hard interrupt instead of the timer softirq. */
+#define TIMER_IRQSAFE	0x1
+
+/*
+ * A timer may be deferred by up to slack ticks, so the timers expiring close
+ * to each other are rounded to the same tick and run in one batch. The
+ * functions run in the timer softirq with the interrupts enabled, unless the
+ * timer is TIMER_IRQSAFE.
+ */
 struct timer {
-	unsigned long	expires;
-	size_t		i;
-	void		(*func)(struct timer *timer);
+	unsigned long			expires;
+	unsigned long			slack;
+	unsigned int			flags;
+	LIST_ENTRY(, timer)		link;
+	void				(*func)(struct timer *timer);
 };
 
+static inline void timer_init(struct timer *timer,
+			      void (*func)(struct timer *timer))
+{
+	timer->slack = 0;
+	timer->flags = 0;
+	LIST_ENTRY_INIT(&timer->link);
+	timer->func = func;
+}
+
 struct wall_clock {
-	struct timeval	tv;
 	struct timezone	tz;
 };
 
@@ -60,12 +91,72 @@ enum {
 
 extern struct wall_clock wall_clock;
 
-void timer_update(void);
-
 void timer_add(struct timer *timer);
 
-void timer_delete(struct timer *timer);
+/*
+ * Waits for the function to return if it is running in the softirq, so the
+ * interrupts must be enabled unless the timer is TIMER_IRQSAFE.
+ */
+void timer_del(struct timer *timer);
 
 long schedule_timeout(unsigned long timeout);
 
+void timer_softirq(void);
+
+/* A device which generates the timer interrupts in the one-shot mode. */
+struct clock_event {
+	const char	*name;
+	int		rating;  /* the higher the better */
+	uint64_t	min_delta_ns;
+	uint64_t	max_delta_ns;
+	/* Programs a single interrupt delta_ns later. */
+	void		(*set_next_event)(uint64_t delta_ns);
+};
+
+void clock_event_register(struct clock_event *ce);
+void clock_event_handler(void);
+void clock_event_reprogram(void);
+
+static inline void ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_nsec = div64_32(&ns, NSECS_PER_SEC);
+	ts->tv_sec = ns;
+}
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * NSECS_PER_SEC + ts->tv_nsec;
+}
+
+static inline bool timespec_valid(const struct timespec *ts)
+{
+	return ts->tv_sec >= 0 && ts->tv_nsec >= 0 &&
+	       ts->tv_nsec < NSECS_PER_SEC;
+}
+
+struct clocksource;
+
+struct clocksource *timekeeping_clocksource(void);
+void timekeeping_set_clocksource(struct clocksource *cs);
+
+/* Returns the CLOCK_MONOTONIC time in ns. */
+uint64_t timekeeping_ns(void);
+
+/* Converts the absolute time of clk_id to CLOCK_MONOTONIC ns. */
+uint64_t timekeeping_abs_ns(clockid_t clk_id, const struct timespec *ts);
+uint64_t __timekeeping_abs_ns(clockid_t clk_id, const struct timespec *ts);
+
+#if CONFIG_NO_HZ
+void timer_idle_enter(void);
+void timer_idle_exit(void);
+#else
+static inline void timer_idle_enter(void)
+{
+}
+
+static inline void timer_idle_exit(void)
+{
+}
+#endif
+
 #endif  /* TIMER_H */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <clocksource.h>
+#include <timer.h>
+#include <stdio.h>
+#include <arch.h>
+
+/* The fallback, which has only the resolution of a tick. */
+static uint64_t jiffies_read(void)
+{
+	return ticks;
+}
+
+struct clocksource clocksource_jiffies = {
+	.name	= "jiffies",
+	.rating	= 1,
+	.read	= jiffies_read,
+	.mask	= 0xffffffff,
+	.mult	= NSECS_PER_TICK,
+	.shift	= 0,
+};
+
+/*
+ * Calculates the mult and shift which convert from the frequency from to the
+ * frequency to, with the highest precision which doesn't overflow for maxsec
+ * seconds worth of cycles.
+ */
+void clocks_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from,
+			    uint32_t to, uint32_t maxsec)
+{
+	uint64_t tmp;
+	uint32_t sft, sftacc = 32;
+
+	tmp = ((uint64_t)maxsec * from) >> 32;
+	while (tmp) {
+		tmp >>= 1;
+		sftacc--;
+	}
+
+	for (sft = 32; sft > 0; sft--) {
+		tmp = (uint64_t)to << sft;
+		tmp += from / 2;
+		div64_32(&tmp, from);
+		if ((tmp >> sftacc) == 0)
+			break;
+	}
+	*mult = tmp;
+	*shift = sft;
+}
+
+void clocksource_register_hz(struct clocksource *cs, uint32_t hz)
+{
+	clocks_calc_mult_shift(&cs->mult, &cs->shift, hz, NSECS_PER_SEC,
+			       CLOCKSOURCE_MAXSEC);
+	clocksource_register(cs);
+}
+
+void clocksource_register_khz(struct clocksource *cs, uint32_t khz)
+{
+	clocks_calc_mult_shift(&cs->mult, &cs->shift, khz, NSECS_PER_MSEC,
+			       CLOCKSOURCE_MAXSEC * MSECS_PER_SEC);
+	clocksource_register(cs);
+}
+
+void clocksource_register(struct clocksource *cs)
+{
+	unsigned long flags = interrupt_disable();
+	struct clocksource *curr = timekeeping_clocksource();
+
+	if (cs->rating > curr->rating) {
+		timekeeping_set_clocksource(cs);
+		printf("Clocksource: %s\n", cs->name);
+	}
+	interrupt_enable(flags);
+}
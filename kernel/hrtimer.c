@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <config.h>
+#include <hrtimer.h>
+#include <timer.h>
+#include <pthread.h>
+#include <interrupt.h>
+#include <kernel.h>
+
+/*
+ * The pending timers are kept in a pairing heap linked through the timers
+ * themselves, so any number of them can be pending.
+ */
+static struct {
+	struct hrtimer	*root;
+	bool		running;
+} hrtimer_context;
+
+/* Melds two heaps, and returns the root of the result. */
+static struct hrtimer *heap_meld(struct hrtimer *a, struct hrtimer *b)
+{
+	struct hrtimer *tmp;
+
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	if (b->expires < a->expires) {
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+	b->prev = a;
+	b->sibling = a->child;
+	if (a->child)
+		a->child->prev = b;
+	a->child = b;
+
+	return a;
+}
+
+/* Melds the sibling list in pairs from the left, then from the right. */
+static struct hrtimer *heap_merge_pairs(struct hrtimer *first)
+{
+	struct hrtimer *a, *b, *next, *list = NULL, *root = NULL;
+
+	while (first) {
+		a = first;
+		b = a->sibling;
+		next = b ? b->sibling : NULL;
+		a->prev = a->sibling = NULL;
+		if (b) {
+			b->prev = b->sibling = NULL;
+			a = heap_meld(a, b);
+		}
+		a->sibling = list;
+		list = a;
+		first = next;
+	}
+	while (list) {
+		next = list->sibling;
+		list->sibling = NULL;
+		root = heap_meld(root, list);
+		list = next;
+	}
+
+	return root;
+}
+
+static void __hrtimer_cancel(struct hrtimer *timer)
+{
+	struct hrtimer *sub = heap_merge_pairs(timer->child);
+
+	if (timer == hrtimer_context.root) {
+		hrtimer_context.root = sub;
+	} else {
+		if (timer->prev->child == timer)
+			timer->prev->child = timer->sibling;
+		else
+			timer->prev->sibling = timer->sibling;
+		if (timer->sibling)
+			timer->sibling->prev = timer->prev;
+		hrtimer_context.root = heap_meld(hrtimer_context.root, sub);
+	}
+	timer->queued = false;
+}
+
+/* See timer_apply_slack(). */
+static uint64_t hrtimer_apply_slack(uint64_t expires, uint64_t slack)
+{
+	uint64_t limit = expires + slack;
+	uint64_t mask = expires ^ limit;
+
+	if (mask == 0)
+		return expires;
+	mask = (1ULL << (fls64(mask) - 1)) - 1;
+
+	return limit & ~mask;
+}
+
+void hrtimer_start_range(struct hrtimer *timer, uint64_t expires,
+			 uint64_t slack)
+{
+	unsigned long flags = interrupt_disable();
+
+	if (timer->queued)
+		__hrtimer_cancel(timer);
+	timer->expires = hrtimer_apply_slack(expires, slack);
+	timer->child = timer->sibling = timer->prev = NULL;
+	timer->queued = true;
+	hrtimer_context.root = heap_meld(hrtimer_context.root, timer);
+	if (hrtimer_context.root == timer && !hrtimer_context.running)
+		clock_event_reprogram();
+	interrupt_enable(flags);
+}
+
+void hrtimer_cancel(struct hrtimer *timer)
+{
+	unsigned long flags = interrupt_disable();
+
+	if (timer->queued)
+		__hrtimer_cancel(timer);
+	interrupt_enable(flags);
+}
+
+void hrtimer_run(uint64_t now)
+{
+	struct hrtimer *timer;
+
+	hrtimer_context.running = true;
+	while ((timer = hrtimer_context.root) && timer->expires <= now) {
+		__hrtimer_cancel(timer);
+		timer->func(timer);
+	}
+	hrtimer_context.running = false;
+}
+
+uint64_t hrtimer_next(void)
+{
+	if (!hrtimer_context.root)
+		return UINT64_MAX;
+
+	return hrtimer_context.root->expires;
+}
+
+struct sched_hrtimer {
+	struct hrtimer	timer;
+	pthread_t	thread;
+};
+
+static void sched_hrtimeout(struct hrtimer *timer)
+{
+	struct sched_hrtimer *sched_timer;
+
+	sched_timer = container_of(timer, struct sched_hrtimer, timer);
+	wake_up(sched_timer->thread);
+}
+
+int64_t schedule_hrtimeout_range(uint64_t expires, uint64_t slack)
+{
+	struct sched_hrtimer t;
+	uint64_t now;
+
+	assert(!in_irq);
+
+	now = timekeeping_ns();
+	if (expires <= now) {
+		pthread_current->state = PTHREAD_STATE_RUNNING;
+		return expires - now;
+	}
+	hrtimer_init(&t.timer, sched_hrtimeout);
+	t.thread = pthread_current;
+	hrtimer_start_range(&t.timer, expires, slack);
+	schedule();
+	hrtimer_cancel(&t.timer);
+
+	return expires - timekeeping_ns();
+}
+
+int64_t schedule_hrtimeout(uint64_t expires)
+{
+	return schedule_hrtimeout_range(expires, pthread_current->timer_slack);
+}
+
+uint64_t hrtimer_forward(uint64_t *expires, uint64_t now, uint64_t interval)
+{
+	uint64_t n = 0;
+
+	if (*expires > now)
+		return 0;
+	if (interval <= UINT32_MAX) {
+		n = now - *expires;
+		div64_32(&n, interval);
+		*expires += n * interval;
+	}
+	while (*expires <= now) {
+		*expires += interval;
+		n++;
+	}
+
+	return n;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <config.h>
+#include <idle.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <timer.h>
+#include <pthread.h>
+#include <interrupt.h>
+#include <arch.h>
+#include <smp.h>
+
+/* The poll window in ns, 0 to sleep at once. */
+#ifndef CONFIG_IDLE_POLL_NS
+#define CONFIG_IDLE_POLL_NS 0
+#endif
+
+static struct {
+	int		mode;
+	unsigned long	poll_ns;
+} idle_context = {
+	.mode		= IDLE_HALT,
+	.poll_ns	= CONFIG_IDLE_POLL_NS,
+};
+
+/* Only touched by the idle thread of the CPU and its interrupts. */
+static struct idle_cpu {
+	bool			sleeping;
+	int			sleep_mode;  /* the one entered */
+	uint64_t		sleep_start;
+	struct idle_stats	stats;
+} idle_cpus[NR_CPUS];
+
+/*
+ * Spins with the interrupts enabled. A thread woken up by an interrupt
+ * preempts the idle thread on the return of the interrupt, which shows as an
+ * involuntary context switch of the idle thread. A wakeup which has not
+ * switched yet, e.g. from another CPU before its IPI lands, shows in the run
+ * queue. Returns true if either happened in the window.
+ */
+static bool idle_poll(struct idle_cpu *ic, unsigned long window)
+{
+	unsigned long nivcsw = pthread_current->nivcsw;
+	uint64_t start, now;
+	bool hit = false;
+
+	ic->stats.poll_entries++;
+	start = timekeeping_ns();
+	do {
+		cpu_relax();
+		if (pthread_current->nivcsw != nivcsw ||
+		    pthread_resched_pending()) {
+			hit = true;
+			break;
+		}
+		now = timekeeping_ns();
+	} while (now - start < window);
+	if (hit) {
+		ic->stats.poll_hits++;
+		now = timekeeping_ns();
+	}
+	ic->stats.poll_ns += now - start;
+
+	return hit;
+}
+
+void cpu_idle(void)
+{
+	struct idle_cpu *ic = &idle_cpus[smp_processor_id()];
+	unsigned long window;
+	int mode;
+
+	for (;;) {
+		window = idle_context.poll_ns;
+		if (window > 0 && idle_poll(ic, window)) {
+			schedule();
+			continue;
+		}
+		interrupt_disable();
+		/* Only the boot CPU drives the tick. */
+		if (smp_processor_id() == 0)
+			timer_idle_enter();
+		mode = idle_context.mode;
+		ic->stats.entries[mode]++;
+		ic->sleep_mode = mode;
+		ic->sleep_start = timekeeping_ns();
+		ic->sleeping = true;
+		if (mode == IDLE_MWAIT)
+#if CONFIG_SMP
+			arch_safe_mwait(&this_cpu_ptr()->next);
+#else
+			arch_safe_mwait(&pthread_next);
+#endif
+		else
+			arch_safe_halt();
+		/* mwait may also wake up without an interrupt. */
+		interrupt_disable();
+		cpu_idle_exit();
+		arch_enable_interrupt();
+	}
+}
+
+void cpu_idle_exit(void)
+{
+	struct idle_cpu *ic = &idle_cpus[smp_processor_id()];
+
+	if (ic->sleeping) {
+		ic->sleeping = false;
+		ic->stats.residency_ns[ic->sleep_mode] +=
+			timekeeping_ns() - ic->sleep_start;
+	}
+	if (smp_processor_id() == 0)
+		timer_idle_exit();
+}
+
+int idle_set_mode(int mode)
+{
+	unsigned long flags;
+
+	if (mode < 0 || mode >= IDLE_MODE_NUM)
+		return EINVAL;
+	if (mode == IDLE_MWAIT && !cpu_has_mwait())
+		return EINVAL;
+	flags = interrupt_disable();
+	idle_context.mode = mode;
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+int idle_get_mode(void)
+{
+	return idle_context.mode;
+}
+
+void idle_set_poll_ns(unsigned long ns)
+{
+	idle_context.poll_ns = ns;
+}
+
+unsigned long idle_get_poll_ns(void)
+{
+	return idle_context.poll_ns;
+}
+
+void idle_get_stats(struct idle_stats *stats)
+{
+	const struct idle_stats *s;
+	unsigned long flags;
+	unsigned int cpu;
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+	flags = interrupt_disable();
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		s = &idle_cpus[cpu].stats;
+		stats->poll_entries += s->poll_entries;
+		stats->poll_hits += s->poll_hits;
+		stats->poll_ns += s->poll_ns;
+		for (i = 0; i < IDLE_MODE_NUM; i++) {
+			stats->entries[i] += s->entries[i];
+			stats->residency_ns[i] += s->residency_ns[i];
+		}
+	}
+	interrupt_enable(flags);
+}
@@ -22,6 +22,67 @@
  * THE SOFTWARE.
  */
 
+#include <config.h>
 #include <interrupt.h>
+#include <timer.h>
 
+#ifndef CONFIG_SOFTIRQ_RESTART_MAX
+#define CONFIG_SOFTIRQ_RESTART_MAX 10
+#endif
+
+#if CONFIG_SMP
+/* Serializes the softirqs across the CPUs. */
+static bool softirq_running = false;
+#else
 bool in_irq = false;
+bool in_softirq = false;
+#endif
+
+static unsigned long softirq_pending;
+
+static void (*const softirq_handler[SOFTIRQ_MAX])(void) = {
+	[SOFTIRQ_TIMER]	= timer_softirq,
+};
+
+void raise_softirq(unsigned int nr)
+{
+	unsigned long flags = interrupt_disable();
+
+	softirq_pending |= 1UL << nr;
+	interrupt_enable(flags);
+}
+
+/*
+ * The softirqs raised again while running are rerun at most
+ * CONFIG_SOFTIRQ_RESTART_MAX times, and then left for the next interrupt.
+ */
+void do_softirq(void)
+{
+	int restart = CONFIG_SOFTIRQ_RESTART_MAX;
+	unsigned long pending;
+	unsigned int nr;
+
+	if (in_softirq)
+		return;
+#if CONFIG_SMP
+	/* The CPU running them also reruns the ones raised meanwhile. */
+	if (softirq_running)
+		return;
+	softirq_running = true;
+#endif
+	in_softirq = true;
+	while (softirq_pending && restart-- > 0) {
+		pending = softirq_pending;
+		softirq_pending = 0;
+		arch_enable_interrupt();
+		for (nr = 0; pending; ++nr, pending >>= 1) {
+			if (pending & 1)
+				softirq_handler[nr]();
+		}
+		interrupt_disable();
+	}
+	in_softirq = false;
+#if CONFIG_SMP
+	softirq_running = false;
+#endif
+}
@@ -30,6 +30,9 @@
 #include <application.h>
 #include <interrupt.h>
 #include <arch.h>
+#include <timer.h>
+#include <idle.h>
+#include <smp.h>
 
 extern init_func_t * const application_init_begin[];
 extern init_func_t * const application_init_end[];
@@ -39,6 +42,7 @@ int main(struct multiboot_info *info)
 {
 	init_func_t * const *func;
 
+	smp_init();
 	arch_early_init();
 
 	if ((info->flags & 1) == 0) {
@@ -64,11 +68,9 @@ int main(struct multiboot_info *info)
 	}
 	in_irq = 0;
 
+	smp_boot();
 	arch_enable_interrupt();
 	pthread_yield();
 
-	for (;;)
-		arch_halt();
-
-	return 0;
+	cpu_idle();
 }
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <config.h>
+#include <time.h>
+#include <signal.h>
+#include <timer.h>
+#include <hrtimer.h>
+#include <pthread.h>
+#include <event.h>
+#include <interrupt.h>
+#include <kernel.h>
+#include <limits.h>
+
+#include <sys/param.h>
+#include <sys/queue.h>
+
+#ifndef CONFIG_POSIX_TIMER_MAX_NUM
+#define CONFIG_POSIX_TIMER_MAX_NUM 16
+#endif
+
+#ifndef CONFIG_POSIX_TIMER_PRIORITY
+#define CONFIG_POSIX_TIMER_PRIORITY SCHED_RR_PRIORITY_MAX
+#endif
+
+#ifndef CONFIG_POSIX_TIMER_STACK_SIZE
+#define CONFIG_POSIX_TIMER_STACK_SIZE 1024
+#endif
+
+enum {
+	POSIX_TIMER_EVENT_PENDING	= 0x01
+};
+
+struct posix_timer {
+	bool				used;
+	clockid_t			clk_id;
+	struct sigevent			sigev;
+	struct hrtimer			timer;
+	uint64_t			expires;  /* 0 if disarmed */
+	uint64_t			interval;
+	int				overrun;
+	int				overrun_last;  /* of the last notification */
+	TAILQ_ENTRY(, posix_timer)	link;  /* waiting for the notification */
+};
+
+TAILQ_HEAD(posix_timer_queue, posix_timer);
+
+/*
+ * The SIGEV_THREAD notifications are run by a single service thread, which is
+ * started by the first timer_create() asking for them.
+ */
+static struct {
+	struct posix_timer		timers[CONFIG_POSIX_TIMER_MAX_NUM];
+	struct posix_timer_queue	pending;
+	event_t				event;
+	bool				started;
+	spinlock_t			lock;  /* allocates the slots */
+} posix_timer_context = {
+	.lock	= SPINLOCK_INITIALIZER,
+};
+
+static unsigned long
+posix_timer_stack[CONFIG_POSIX_TIMER_STACK_SIZE / sizeof(unsigned long)];
+
+static struct posix_timer *posix_timer_get(timer_t timerid)
+{
+	if (timerid < 0 || timerid >= CONFIG_POSIX_TIMER_MAX_NUM ||
+	    !posix_timer_context.timers[timerid].used)
+		return NULL;
+
+	return &posix_timer_context.timers[timerid];
+}
+
+static void posix_timer_add_overrun(struct posix_timer *timer, uint64_t n)
+{
+	timer->overrun = MIN(timer->overrun + n, DELAYTIMER_MAX);
+}
+
+/*
+ * Runs in the hard interrupt. A periodic timer is restarted right away, and
+ * its expiries are counted as overruns while the notification is pending.
+ */
+static void posix_timer_expire(struct hrtimer *hrtimer)
+{
+	struct posix_timer *timer;
+
+	timer = container_of(hrtimer, struct posix_timer, timer);
+	if (timer->interval) {
+		posix_timer_add_overrun(timer,
+				hrtimer_forward(&timer->expires,
+						timekeeping_ns(),
+						timer->interval) - 1);
+		hrtimer_start(&timer->timer, timer->expires);
+	} else {
+		timer->expires = 0;
+	}
+	if (timer->sigev.sigev_notify != SIGEV_THREAD)
+		return;
+	if (TAILQ_ENTRY_EMPTY(&timer->link)) {
+		TAILQ_INSERT_TAIL(&posix_timer_context.pending, timer, link);
+		event_set(&posix_timer_context.event,
+			  POSIX_TIMER_EVENT_PENDING);
+	} else {
+		posix_timer_add_overrun(timer, 1);
+	}
+}
+
+static void *posix_timer_thread(void *arg)
+{
+	struct posix_timer *timer;
+	void (*func)(union sigval value);
+	union sigval value;
+	unsigned long flags;
+
+	(void)arg;
+	flags = interrupt_disable();
+	for (;;) {
+		while (!(timer = TAILQ_FIRST(&posix_timer_context.pending))) {
+			event_wait(&posix_timer_context.event,
+				   POSIX_TIMER_EVENT_PENDING, EVENT_CLEAR, NULL);
+		}
+		TAILQ_REMOVE(&posix_timer_context.pending, timer, link);
+		TAILQ_ENTRY_INIT(&timer->link);
+		timer->overrun_last = timer->overrun;
+		timer->overrun = 0;
+		func = timer->sigev.sigev_notify_function;
+		value = timer->sigev.sigev_value;
+		interrupt_enable(flags);
+		func(value);
+		flags = interrupt_disable();
+	}
+
+	return NULL;
+}
+
+static int posix_timer_thread_start(void)
+{
+	struct sched_param sched_param;
+	pthread_attr_t attr;
+	pthread_t tid;
+	int retval;
+	unsigned long flags = interrupt_disable();
+
+	if (posix_timer_context.started) {
+		interrupt_enable(flags);
+		return 0;
+	}
+	posix_timer_context.started = true;
+	TAILQ_INIT(&posix_timer_context.pending);
+	event_init(&posix_timer_context.event, 0);
+	interrupt_enable(flags);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, posix_timer_stack,
+			      sizeof(posix_timer_stack));
+	sched_param.sched_priority = CONFIG_POSIX_TIMER_PRIORITY;
+	pthread_attr_setschedparam(&attr, &sched_param);
+	retval = pthread_create(&tid, &attr, posix_timer_thread, NULL);
+	pthread_attr_destroy(&attr);
+	if (retval) {
+		posix_timer_context.started = false;
+		return retval;
+	}
+	pthread_setname_np(tid, "posix_timer");
+	pthread_detach(tid);
+
+	return 0;
+}
+
+int timer_create(clockid_t clk_id, struct sigevent *sevp, timer_t *timerid)
+{
+	struct posix_timer *timer = NULL;
+	int i, retval;
+
+	if ((clk_id != CLOCK_REALTIME && clk_id != CLOCK_MONOTONIC) || !sevp ||
+	    (sevp->sigev_notify != SIGEV_NONE &&
+	     sevp->sigev_notify != SIGEV_THREAD)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (sevp->sigev_notify == SIGEV_THREAD) {
+		retval = posix_timer_thread_start();
+		if (retval) {
+			errno = retval;
+			return -1;
+		}
+	}
+
+	preempt_lock(&posix_timer_context.lock);
+	for (i = 0; i < CONFIG_POSIX_TIMER_MAX_NUM; ++i) {
+		if (!posix_timer_context.timers[i].used) {
+			timer = &posix_timer_context.timers[i];
+			timer->used = true;
+			break;
+		}
+	}
+	preempt_unlock(&posix_timer_context.lock);
+	if (!timer) {
+		errno = EAGAIN;
+		return -1;
+	}
+	timer->clk_id = clk_id;
+	timer->sigev = *sevp;
+	hrtimer_init(&timer->timer, posix_timer_expire);
+	timer->expires = 0;
+	timer->interval = 0;
+	timer->overrun = 0;
+	timer->overrun_last = 0;
+	TAILQ_ENTRY_INIT(&timer->link);
+	*timerid = i;
+
+	return 0;
+}
+
+int timer_delete(timer_t timerid)
+{
+	struct posix_timer *timer;
+	unsigned long flags = interrupt_disable();
+
+	timer = posix_timer_get(timerid);
+	if (!timer) {
+		interrupt_enable(flags);
+		errno = EINVAL;
+		return -1;
+	}
+	hrtimer_cancel(&timer->timer);
+	if (!TAILQ_ENTRY_EMPTY(&timer->link))
+		TAILQ_REMOVE(&posix_timer_context.pending, timer, link);
+	timer->used = false;
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+static void __timer_gettime(struct posix_timer *timer,
+			    struct itimerspec *curr_value)
+{
+	uint64_t now = timekeeping_ns();
+
+	ns_to_timespec(timer->expires > now ? timer->expires - now : 0,
+		       &curr_value->it_value);
+	ns_to_timespec(timer->interval, &curr_value->it_interval);
+}
+
+int timer_settime(timer_t timerid, int flags,
+		  const struct itimerspec *new_value,
+		  struct itimerspec *old_value)
+{
+	struct posix_timer *timer;
+	uint64_t expires = 0;
+	unsigned long irq_flags;
+
+	if (!timespec_valid(&new_value->it_value) ||
+	    !timespec_valid(&new_value->it_interval)) {
+		errno = EINVAL;
+		return -1;
+	}
+	irq_flags = interrupt_disable();
+	timer = posix_timer_get(timerid);
+	if (!timer) {
+		interrupt_enable(irq_flags);
+		errno = EINVAL;
+		return -1;
+	}
+	if (old_value)
+		__timer_gettime(timer, old_value);
+	hrtimer_cancel(&timer->timer);
+	if (new_value->it_value.tv_sec || new_value->it_value.tv_nsec) {
+		if (flags & TIMER_ABSTIME) {
+			expires = __timekeeping_abs_ns(timer->clk_id,
+						       &new_value->it_value);
+		} else {
+			expires = timekeeping_ns() +
+				  timespec_to_ns(&new_value->it_value);
+		}
+		expires = MAX(expires, 1);
+	}
+	timer->expires = expires;
+	timer->interval = timespec_to_ns(&new_value->it_interval);
+	timer->overrun = 0;
+	if (expires)
+		hrtimer_start(&timer->timer, expires);
+	interrupt_enable(irq_flags);
+
+	return 0;
+}
+
+int timer_gettime(timer_t timerid, struct itimerspec *curr_value)
+{
+	struct posix_timer *timer;
+	unsigned long flags = interrupt_disable();
+
+	timer = posix_timer_get(timerid);
+	if (!timer) {
+		interrupt_enable(flags);
+		errno = EINVAL;
+		return -1;
+	}
+	__timer_gettime(timer, curr_value);
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+int timer_getoverrun(timer_t timerid)
+{
+	struct posix_timer *timer = posix_timer_get(timerid);
+
+	if (!timer) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return timer->overrun_last;
+}
@@ -24,6 +24,8 @@
 
 #include <config.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <event.h>
 #include <interrupt.h>
 #include <kernel.h>
 #include <stdlib.h>
@@ -31,7 +33,11 @@
 #include <strings.h>
 #include <string.h>
 #include <timer.h>
+#include <hrtimer.h>
 #include <arch.h>
+#include <smp.h>
+
+#include <sys/param.h>
 
 #ifndef CONFIG_PTHREAD_MAX_NUM
 #define CONFIG_PTHREAD_MAX_NUM 32
@@ -43,52 +49,107 @@
 
 static struct pthread pthreads[CONFIG_PTHREAD_MAX_NUM];
 
-static struct pthread pthread_idle;
+/* The data of the threads which is only touched by the threads. */
+static spinlock_t pthreads_lock = SPINLOCK_INITIALIZER;
+
+/* Every CPU has an idle thread, which is always runnable. */
+static struct pthread pthread_idle[NR_CPUS];
 
-static struct {
+/*
+ * Every CPU has a run queue, and runs the threads in it only. The running
+ * thread stays in the queue.
+ */
+struct run_queue {
 	struct pthread_queue	level[SCHED_RR_PRIORITY_MAX + 1];
 	int			bitmap;
-} run_queue;
+	unsigned int		nr_running;  /* the idle thread included */
+};
+
+static struct run_queue run_queues[NR_CPUS];
+
+#if CONFIG_SMP
+#define pthread_cpu(thread)	((thread)->cpu)
+#else
+#define pthread_cpu(thread)	0
+#endif
+
+static inline bool pthread_is_idle(pthread_t thread)
+{
+	return thread >= pthread_idle && thread < pthread_idle + NR_CPUS;
+}
+
+/* Returns true if the thread is running on a CPU. */
+static inline bool pthread_running(pthread_t thread)
+{
+#if CONFIG_SMP
+	return READ_ONCE(cpus[thread->cpu].current) == thread;
+#else
+	return thread == pthread_current;
+#endif
+}
 
-static void run_queue_init(void)
+static void run_queue_init(struct run_queue *rq)
 {
 	size_t i;
 
-	for (i = 0; i < ARRAY_SIZE(run_queue.level); ++i)
-		TAILQ_INIT(&run_queue.level[i]);
-	run_queue.bitmap = 0;
+	for (i = 0; i < ARRAY_SIZE(rq->level); ++i)
+		TAILQ_INIT(&rq->level[i]);
+	rq->bitmap = 0;
+	rq->nr_running = 0;
+}
+
+#if CONFIG_SMP
+/*
+ * Reschedules the other CPU the thread is queued on if the thread should
+ * preempt the running one, or is the running one.
+ */
+static void run_queue_check_preempt(pthread_t thread)
+{
+	struct cpu *cpu = &cpus[thread->cpu];
+	pthread_t current = cpu->current;
+
+	if ((current == thread || pthread_is_idle(current) ||
+	     thread->effective_priority > current->effective_priority) &&
+	    cpu->next) {
+		cpu->next = NULL;
+		smp_send_reschedule(thread->cpu);
+	}
 }
+#endif
 
 static void run_queue_enqueue(pthread_t thread, bool head)
 {
-	struct pthread_queue *q = &run_queue.level[thread->effective_priority];
+	struct run_queue *rq = &run_queues[pthread_cpu(thread)];
+	struct pthread_queue *q = &rq->level[thread->effective_priority];
 
 	if (TAILQ_EMPTY(q)) {
 		int i = SCHED_RR_PRIORITY_MAX - thread->effective_priority;
 
-		run_queue.bitmap |= (1 << i);
+		rq->bitmap |= (1 << i);
 	}
 #if CONFIG_RR
 	thread->timeslice = CONFIG_TIMESLICE;
 #endif
-	if (head) {
-		TAILQ_INSERT_HEAD(&run_queue.level[thread->effective_priority],
-				  thread, link);
-	} else {
-		TAILQ_INSERT_TAIL(&run_queue.level[thread->effective_priority],
-				  thread, link);
-	}
+	if (head)
+		TAILQ_INSERT_HEAD(q, thread, link);
+	else
+		TAILQ_INSERT_TAIL(q, thread, link);
+	rq->nr_running++;
+#if CONFIG_SMP
+	if (thread->cpu != smp_processor_id())
+		run_queue_check_preempt(thread);
+#endif
 }
 
-static pthread_t run_queue_peek(void)
+static pthread_t run_queue_peek(struct run_queue *rq)
 {
 	struct pthread_queue *q;
 	pthread_t th;
-	int i = ffs(run_queue.bitmap);
+	int i = ffs(rq->bitmap);
 
 	assert(i);
 	--i;
-	q = &run_queue.level[SCHED_RR_PRIORITY_MAX - i];
+	q = &rq->level[SCHED_RR_PRIORITY_MAX - i];
 	th = TAILQ_FIRST(q);
 	assert(th);
 
@@ -98,59 +159,253 @@ static pthread_t run_queue_peek(void)
 static void run_queue_dequeue(pthread_t thread)
 {
 	if (!TAILQ_ENTRY_EMPTY(&thread->link)) {
+		struct run_queue *rq = &run_queues[pthread_cpu(thread)];
 		struct pthread_queue *q;
 
-		q = &run_queue.level[thread->effective_priority];
+		q = &rq->level[thread->effective_priority];
 		TAILQ_REMOVE(q, thread, link);
 		TAILQ_ENTRY_INIT(&thread->link);
 		if (TAILQ_EMPTY(q)) {
 			int i;
 
 			i = SCHED_RR_PRIORITY_MAX - thread->effective_priority;
-			run_queue.bitmap &= ~(1 << i);
+			rq->bitmap &= ~(1 << i);
 		}
+		rq->nr_running--;
 	}
 }
 
-static void __pthread_setschedprio(pthread_t thread);
+#if CONFIG_SMP
+/* Picks the least loaded CPU allowed, preferring the last one on a tie. */
+static unsigned int pthread_select_cpu(pthread_t thread)
+{
+	unsigned long mask = thread->affinity & cpu_online_mask();
+	unsigned int cpu, best = thread->cpu;
+
+	assert(mask);
+	if (!(mask & (1UL << best)))
+		best = ffs(mask) - 1;
+	for (cpu = 0; cpu < nr_cpus; ++cpu) {
+		if ((mask & (1UL << cpu)) &&
+		    run_queues[cpu].nr_running < run_queues[best].nr_running)
+			best = cpu;
+	}
 
-static void __pthread_spread(pthread_t th)
+	return best;
+}
+
+/* Moves the queued thread to the run queue of another allowed CPU. */
+static void run_queue_migrate(pthread_t thread)
 {
-	struct pthread_mutex *mutex;
+	run_queue_dequeue(thread);
+	thread->cpu = pthread_select_cpu(thread);
+	run_queue_enqueue(thread, false);
+}
 
-	for (;;) {
-		mutex = th->sleep_on;
-		if (!mutex)
-			break;
-		th = mutex->owner;
-		__pthread_setschedprio(th);
+/*
+ * Called by a CPU running out of the threads to pull a waiting thread from the
+ * busiest CPU. The threads not running are switched out completely, since the
+ * switches are done under the big lock.
+ */
+static void run_queue_pull(void)
+{
+	unsigned int cpu, self = smp_processor_id(), busiest = self;
+	unsigned int max = 2;  /* the idle thread and the running one */
+	struct run_queue *rq;
+	pthread_t th;
+	int bitmap, i;
+
+	for (cpu = 0; cpu < nr_cpus; ++cpu) {
+		if (cpu != self && run_queues[cpu].nr_running > max) {
+			max = run_queues[cpu].nr_running;
+			busiest = cpu;
+		}
+	}
+	if (busiest == self)
+		return;
+	rq = &run_queues[busiest];
+	for (bitmap = rq->bitmap; (i = ffs(bitmap)); bitmap &= ~(1 << (i - 1))) {
+		TAILQ_FOREACH(th, &rq->level[SCHED_RR_PRIORITY_MAX - (i - 1)],
+			      link) {
+			if (th != cpus[busiest].current &&
+			    (th->affinity & (1UL << self))) {
+				run_queue_dequeue(th);
+				th->cpu = self;
+				run_queue_enqueue(th, false);
+				return;
+			}
+		}
 	}
 }
+#endif
 
-static void __pthread_setschedprio(pthread_t thread)
+static void wait_queue_init(struct wait_queue *wq)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(wq->level); ++i)
+		TAILQ_INIT(&wq->level[i]);
+	wq->bitmap = 0;
+}
+
+static inline bool wait_queue_empty(struct wait_queue *wq)
+{
+	return wq->bitmap == 0;
+}
+
+static void wait_queue_enqueue(struct wait_queue *wq, struct wait *w)
+{
+	struct wait_list *l;
+
+	w->priority = w->thread->effective_priority;
+	l = &wq->level[w->priority];
+	if (TAILQ_EMPTY(l))
+		wq->bitmap |= (1 << (SCHED_RR_PRIORITY_MAX - w->priority));
+	TAILQ_INSERT_TAIL(l, w, link);
+}
+
+static void wait_queue_dequeue(struct wait_queue *wq, struct wait *w)
+{
+	struct wait_list *l = &wq->level[w->priority];
+
+	TAILQ_REMOVE(l, w, link);
+	TAILQ_ENTRY_INIT(&w->link);
+	if (TAILQ_EMPTY(l))
+		wq->bitmap &= ~(1 << (SCHED_RR_PRIORITY_MAX - w->priority));
+}
+
+static struct wait *wait_queue_peek(struct wait_queue *wq)
+{
+	int i = ffs(wq->bitmap);
+
+	if (!i)
+		return NULL;
+
+	return TAILQ_FIRST(&wq->level[SCHED_RR_PRIORITY_MAX - (i - 1)]);
+}
+
+/* Moves w to the bucket of the current effective priority of its thread. */
+static void wait_queue_requeue(struct wait_queue *wq, struct wait *w)
+{
+	if (w->priority != w->thread->effective_priority) {
+		wait_queue_dequeue(wq, w);
+		wait_queue_enqueue(wq, w);
+	}
+}
+
+/*
+ * The mutexes held by a thread are kept in descending order of the priorities
+ * of their top waiters, so the priority a thread inherits is always found at
+ * the head of its mutex queue.
+ */
+static void mutex_queue_insert(pthread_t thread, struct pthread_mutex *mutex)
+{
+	struct pthread_mutex *i;
+
+	TAILQ_FOREACH(i, &thread->mutex_queue, link) {
+		if (i->priority < mutex->priority) {
+			TAILQ_INSERT_BEFORE(i, mutex, link);
+			return;
+		}
+	}
+	TAILQ_INSERT_TAIL(&thread->mutex_queue, mutex, link);
+}
+
+/*
+ * The lock word holds the owner, or 0 if the mutex is free. The lowest bit is
+ * set when there may be waiters, so the uncontended lock and unlock are a
+ * single cmpxchg, and only the contended cases disable interrupts to deal with
+ * the wait queue and the priority inheritance.
+ */
+enum {
+	MUTEX_WAITERS = 1
+};
+
+static inline pthread_t mutex_owner(pthread_mutex_t *mutex)
+{
+	return (pthread_t)(mutex->lock & ~MUTEX_WAITERS);
+}
+
+/*
+ * Returns the priority the mutex confers on its owner: the ceiling for
+ * PTHREAD_PRIO_PROTECT, and the priority of the top waiter for
+ * PTHREAD_PRIO_INHERIT.
+ */
+static uint8_t mutex_priority(struct pthread_mutex *mutex)
 {
-	struct pthread_mutex *mutex;
 	struct wait *w;
+
+	if (mutex->protocol == PTHREAD_PRIO_PROTECT)
+		return mutex->prioceiling;
+	if (mutex->protocol == PTHREAD_PRIO_INHERIT &&
+	    (w = wait_queue_peek(&mutex->wq)))
+		return w->priority;
+
+	return SCHED_RR_PRIORITY_MIN;
+}
+
+/*
+ * A priority ceiling mutex always has MUTEX_WAITERS set, so it never takes the
+ * fast paths, and is linked into the mutex queue of its owner as soon as it is
+ * locked.
+ */
+static unsigned long mutex_lock_word(struct pthread_mutex *mutex,
+				     pthread_t owner)
+{
+	if (mutex->protocol == PTHREAD_PRIO_PROTECT ||
+	    !wait_queue_empty(&mutex->wq))
+		return (unsigned long)owner | MUTEX_WAITERS;
+
+	return (unsigned long)owner;
+}
+
+static bool __pthread_update_priority(pthread_t thread)
+{
+	struct pthread_mutex *mutex = TAILQ_FIRST(&thread->mutex_queue);
 	uint8_t prio = thread->priority;
 
-	TAILQ_FOREACH(mutex, &thread->mutex_queue, link) {
-		TAILQ_FOREACH(w, &mutex->wq, link) {
-			if (w->thread->effective_priority > prio)
-				prio = w->thread->effective_priority;
-		}
+	if (mutex && mutex->priority > prio)
+		prio = mutex->priority;
+	if (thread->effective_priority == prio)
+		return false;
+	if (!TAILQ_ENTRY_EMPTY(&thread->link)) {
+		run_queue_dequeue(thread);
+		thread->effective_priority = prio;
+		run_queue_enqueue(thread, true);
+	} else {
+		thread->effective_priority = prio;
 	}
-	if (thread->effective_priority != prio) {
-		if (!TAILQ_ENTRY_EMPTY(&thread->link)) {
-			run_queue_dequeue(thread);
-			thread->effective_priority = prio;
-			run_queue_enqueue(thread, true);
-		} else {
-			thread->effective_priority = prio;
-			__pthread_spread(thread);
-		}
+
+	return true;
+}
+
+static void __pthread_spread(pthread_t th)
+{
+	struct pthread_mutex *mutex;
+	uint8_t prio;
+
+	while ((mutex = th->sleep_on)) {
+		wait_queue_requeue(&mutex->wq, th->sleep_wait);
+		prio = mutex_priority(mutex);
+		if (mutex->priority == prio)
+			break;
+		mutex->priority = prio;
+		th = mutex_owner(mutex);
+		if (!th)
+			break;
+		TAILQ_REMOVE(&th->mutex_queue, mutex, link);
+		mutex_queue_insert(th, mutex);
+		if (!__pthread_update_priority(th))
+			break;
 	}
 }
 
+static void __pthread_setschedprio(pthread_t thread)
+{
+	if (__pthread_update_priority(thread))
+		__pthread_spread(thread);
+}
+
 int pthread_setschedprio(pthread_t thread, int priority)
 {
 	if (thread->priority != priority) {
@@ -158,10 +413,8 @@ int pthread_setschedprio(pthread_t thread, int priority)
 
 		if (thread->priority != priority) {
 			thread->priority = priority;
-			if (thread->effective_priority != priority) {
-				__pthread_setschedprio(thread);
-				schedule();
-			}
+			__pthread_setschedprio(thread);
+			schedule();
 		}
 		interrupt_enable(flags);
 	}
@@ -169,40 +422,90 @@ int pthread_setschedprio(pthread_t thread, int priority)
 	return 0;
 }
 
+#if !CONFIG_SMP
 pthread_t pthread_current;
 pthread_t pthread_next;
+volatile unsigned long preempt_count = 0;
+#endif
 
 extern unsigned long idle_stack_bottom;
 
-void pthread_init(void)
+/* The calling CPU becomes the idle thread. */
+static void pthread_idle_init(unsigned int cpu, void *stack_addr)
 {
-	pthread_next = pthread_current = &pthread_idle;
-	run_queue_init();
+	pthread_t idle = &pthread_idle[cpu];
 
-	pthread_idle.state = PTHREAD_STATE_RUNNING;
-	pthread_idle.stack_addr = &idle_stack_bottom;
-	pthread_idle.stack_size = CONFIG_IDLE_STACK_SIZE;
-	TAILQ_ENTRY_INIT(&pthread_idle.link);
-	pthread_idle.priority = SCHED_RR_PRIORITY_IDLE;
-	pthread_idle.effective_priority = SCHED_RR_PRIORITY_IDLE;
+	pthread_next = pthread_current = idle;
+	run_queue_init(&run_queues[cpu]);
+
+	idle->state = PTHREAD_STATE_RUNNING;
+	idle->stack_addr = stack_addr;
+	idle->stack_size = CONFIG_IDLE_STACK_SIZE;
+	TAILQ_ENTRY_INIT(&idle->link);
+	idle->priority = SCHED_RR_PRIORITY_IDLE;
+	idle->effective_priority = SCHED_RR_PRIORITY_IDLE;
 #if CONFIG_RR
-	pthread_idle.timeslice = CONFIG_TIMESLICE;
+	idle->timeslice = CONFIG_TIMESLICE;
+#endif
+	idle->flags = PTHREAD_FLAG_DETACH;
+#if CONFIG_SMP
+	idle->cpu = cpu;
+	idle->affinity = 1UL << cpu;
+#endif
+	strcpy(idle->name, "idle");
+	idle->waiter = NULL;
+	idle->error_code = 0;
+	idle->runtime = 0;
+	idle->wait_time = 0;
+	idle->exec_start = timekeeping_ns();
+	idle->wait_start = 0;
+	idle->nvcsw = 0;
+	idle->nivcsw = 0;
+	idle->timer_slack = CONFIG_TIMER_SLACK_NS;
+	memset(&idle->period, 0, sizeof(idle->period));
+	run_queue_enqueue(idle, false);
+	idle->sleep_on = NULL;
+	TAILQ_INIT(&idle->mutex_queue);
+}
+
+void pthread_init(void)
+{
+	pthread_idle_init(0, &idle_stack_bottom);
+}
+
+#if CONFIG_SMP
+void pthread_init_cpu(unsigned int cpu, void *stack_addr)
+{
+	pthread_idle_init(cpu, stack_addr);
+}
 #endif
-	pthread_idle.flags = PTHREAD_FLAG_DETACH;
-	strcpy(pthread_idle.name, "idle");
-	pthread_idle.waiter = NULL;
-	pthread_idle.error_code = 0;
-	pthread_idle.stime.tv_sec = 0;
-	pthread_idle.stime.tv_usec = 0;
-	run_queue_enqueue(&pthread_idle, false);
-	pthread_idle.sleep_on = NULL;
-	TAILQ_INIT(&pthread_idle.mutex_queue);
+
+static void pthread_account_switch(pthread_t prev, pthread_t next)
+{
+	uint64_t now = timekeeping_ns();
+
+	prev->runtime += now - prev->exec_start;
+	if (prev->state == PTHREAD_STATE_RUNNING) {
+		prev->wait_start = now;
+		prev->nivcsw++;
+	} else {
+		prev->nvcsw++;
+	}
+	next->wait_time += now - next->wait_start;
+	next->exec_start = now;
 }
 
 void __schedule(void)
 {
+	struct run_queue *rq = &run_queues[smp_processor_id()];
+
 	if (pthread_current->state != PTHREAD_STATE_RUNNING) {
 		run_queue_dequeue(pthread_current);
+#if CONFIG_SMP
+	} else if (!(pthread_current->affinity &
+		     (1UL << smp_processor_id()))) {
+		run_queue_migrate(pthread_current);
+#endif
 #if CONFIG_RR
 	} else if (pthread_current->timeslice == 0) {
 		run_queue_dequeue(pthread_current);
@@ -210,7 +513,13 @@ void __schedule(void)
 #endif
 	}
 
-	pthread_next = run_queue_peek();
+#if CONFIG_SMP
+	if (rq->nr_running == 1)
+		run_queue_pull();
+#endif
+	pthread_next = run_queue_peek(rq);
+	if (pthread_next != pthread_current)
+		pthread_account_switch(pthread_current, pthread_next);
 }
 
 void schedule(void)
@@ -224,19 +533,44 @@ void schedule(void)
 	}
 
 	flags = interrupt_disable();
-	__schedule();
-	if (pthread_next != pthread_current)
-		arch_context_switch();
+	/* sleeping with the preemption disabled is a bug */
+	assert(!preempt_count ||
+	       pthread_current->state == PTHREAD_STATE_RUNNING);
+	if (preempt_count && pthread_current->state == PTHREAD_STATE_RUNNING) {
+		pthread_next = NULL;
+	} else {
+		__schedule();
+		if (pthread_next != pthread_current)
+			arch_context_switch();
+	}
 	interrupt_enable(flags);
 }
 
+void preempt_enable(void)
+{
+	barrier();
+	if (--preempt_count == 0 && !pthread_next && !in_irq)
+		schedule();
+}
+
+bool pthread_resched_pending(void)
+{
+	return !READ_ONCE(pthread_next) ||
+	       READ_ONCE(run_queues[smp_processor_id()].nr_running) > 1;
+}
+
 static void __pthread_set_running(pthread_t th)
 {
 	unsigned long flags = interrupt_disable();
 
 	th->state = PTHREAD_STATE_RUNNING;
-	if (TAILQ_ENTRY_EMPTY(&th->link))
+	if (TAILQ_ENTRY_EMPTY(&th->link)) {
+		th->wait_start = timekeeping_ns();
+#if CONFIG_SMP
+		th->cpu = pthread_select_cpu(th);
+#endif
 		run_queue_enqueue(th, false);
+	}
 	interrupt_enable(flags);
 }
 
@@ -373,20 +707,27 @@ int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
 		   void *(*start_routine)(void *), void *arg)
 {
 	unsigned int i;
-	unsigned long flags;
 	pthread_t th;
 
-	flags = interrupt_disable();
+	preempt_lock(&pthreads_lock);
 	for (i = 0; i < ARRAY_SIZE(pthreads); ++i) {
 		if (pthreads[i].state == PTHREAD_STATE_NONE) {
 			pthreads[i].state = PTHREAD_STATE_INIT;
 			break;
 		}
 	}
-	interrupt_enable(flags);
+	preempt_unlock(&pthreads_lock);
 	if (i == ARRAY_SIZE(pthreads))
 		return EAGAIN;
 	th = &pthreads[i];
+#if CONFIG_SMP
+	/* A detached thread frees its slot before it is switched out. */
+	while (pthread_running(th))
+		cpu_relax();
+	th->cpu = smp_processor_id();
+	th->affinity = pthread_is_idle(pthread_current) ? ~0UL :
+		       pthread_current->affinity;
+#endif
 	th->retval = NULL;
 	stack_check_init(attr->stack_addr, attr->stack_size);
 	th->stack_addr = attr->stack_addr;
@@ -403,8 +744,12 @@ int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
 	strcpy(th->name, "unnamed");
 	th->waiter = NULL;
 	th->error_code = 0;
-	th->stime.tv_sec = 0;
-	th->stime.tv_usec = 0;
+	th->runtime = 0;
+	th->wait_time = 0;
+	th->nvcsw = 0;
+	th->nivcsw = 0;
+	th->timer_slack = pthread_current->timer_slack;
+	memset(&th->period, 0, sizeof(th->period));
 	arch_pthread_init(th, __start_routine, start_routine, arg);
 	wake_up(th);
 	*thread = th;
@@ -422,15 +767,15 @@ int pthread_yield(void)
 int pthread_getname_np(pthread_t thread, char *buf, size_t size)
 {
 	int retval = 0;
-	size_t len = strlen(thread->name);
-	unsigned long flags = interrupt_disable();
+	size_t len;
 
+	preempt_lock(&pthreads_lock);
+	len = strlen(thread->name);
 	if (len >= size)
 		retval = ERANGE;
 	else
 		memcpy(buf, thread->name, len + 1);
-
-	interrupt_enable(flags);
+	preempt_unlock(&pthreads_lock);
 
 	return retval;
 }
@@ -439,191 +784,611 @@ int pthread_setname_np(pthread_t thread, const char *name)
 {
 	int retval = 0;
 	size_t size = strlen(name);
-	unsigned long flags = interrupt_disable();
 
+	preempt_lock(&pthreads_lock);
 	if (size >= sizeof(thread->name))
 		retval = ERANGE;
 	else
 		memcpy(thread->name, name, size + 1);
-
-	interrupt_enable(flags);
+	preempt_unlock(&pthreads_lock);
 
 	return retval;
 }
 
-static inline int atomic_sub_return(int v, volatile int *ptr)
+int pthread_gettimerslack_np(pthread_t thread, unsigned long *slack)
 {
-	return atomic_add_return(-v, ptr);
+	*slack = thread->timer_slack;
+
+	return 0;
 }
 
-int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
+int pthread_settimerslack_np(pthread_t thread, unsigned long slack)
 {
-	mutex->lock = 1;
-	TAILQ_INIT(&mutex->wq);
-	mutex->type = attr->type;
-	mutex->owner = NULL;
-	mutex->recursive_count = 0;
+	thread->timer_slack = slack;
 
 	return 0;
 }
 
-int pthread_mutex_destroy(pthread_mutex_t *mutex)
+int pthread_make_periodic_np(pthread_t thread, const struct timespec *start,
+			     const struct timespec *period)
 {
-	(void)mutex;
-	assert(TAILQ_EMPTY(&mutex->wq));
+	uint64_t next, ns;
+
+	if ((start && !timespec_valid(start)) || !timespec_valid(period))
+		return EINVAL;
+	ns = timespec_to_ns(period);
+	next = start ? timespec_to_ns(start) : timekeeping_ns() + ns;
+	preempt_lock(&pthreads_lock);
+	memset(&thread->period, 0, sizeof(thread->period));
+	thread->period.period = ns;
+	thread->period.next = next;
+	preempt_unlock(&pthreads_lock);
 
 	return 0;
 }
 
-int pthread_mutex_lock(pthread_mutex_t *mutex)
+/*
+ * The releases are kept on the grid of the first one, and the timer slack
+ * doesn't apply.
+ */
+int pthread_wait_period_np(unsigned long *overruns)
 {
-	unsigned long flags;
-
-	assert(!in_irq);
+	struct pthread_period *period = &pthread_current->period;
+	uint64_t now, next, jitter, n;
 
-	flags = interrupt_disable();
-	if (mutex->lock == 1) {
-		mutex->lock = 0;
-		TAILQ_INSERT_TAIL(&pthread_current->mutex_queue, mutex, link);
-		mutex->owner = pthread_current;
-		mutex->recursive_count = 1;
-	} else if (mutex->type == PTHREAD_MUTEX_RECURSIVE_NP &&
-		   mutex->owner == pthread_current) {
-		mutex->recursive_count++;
-	} else {
-		struct wait w;
-
-		w.thread = pthread_self();
-		TAILQ_INSERT_TAIL(&mutex->wq, &w, link);
-		pthread_current->sleep_on = mutex;
-		__pthread_spread(pthread_current);
-		for (;;) {
-			if (mutex->lock == 1) {
-				mutex->lock = -1;
-				break;
-			} else {
-				mutex->lock = -1;
-			}
-			pthread_self()->state = PTHREAD_STATE_SLEEPING;
-			schedule();
+	/* The 64-bit fields are read and updated in halves on i386. */
+	for (;;) {
+		preempt_lock(&pthreads_lock);
+		if (!period->period) {
+			preempt_unlock(&pthreads_lock);
+			return EWOULDBLOCK;
 		}
-		pthread_current->sleep_on = NULL;
-		TAILQ_REMOVE(&mutex->wq, &w, link);
-		if (TAILQ_EMPTY(&mutex->wq))
-			mutex->lock = 0;
-		TAILQ_INSERT_TAIL(&pthread_current->mutex_queue, mutex, link);
-		mutex->owner = pthread_current;
-		mutex->recursive_count = 1;
-		__pthread_setschedprio(pthread_current);
+		next = period->next;
+		now = timekeeping_ns();
+		if (now >= next)
+			break;
+		preempt_unlock(&pthreads_lock);
+		pthread_current->state = PTHREAD_STATE_SLEEPING;
+		schedule_hrtimeout_range(next, 0);
 	}
-	interrupt_enable(flags);
+	jitter = now - next;
+	n = hrtimer_forward(&period->next, now, period->period) - 1;
+	period->releases++;
+	if (n > 0) {
+		period->overruns += n;
+	} else {
+		period->jitter_max = MAX(period->jitter_max, jitter);
+		period->jitter_sum += jitter;
+	}
+	preempt_unlock(&pthreads_lock);
+	if (overruns)
+		*overruns = n;
+
+	return n > 0 ? ETIMEDOUT : 0;
+}
+
+int pthread_getperiod_np(pthread_t thread, struct pthread_period *period)
+{
+	preempt_lock(&pthreads_lock);
+	*period = thread->period;
+	preempt_unlock(&pthreads_lock);
 
 	return 0;
 }
 
-int pthread_mutex_trylock(pthread_mutex_t *mutex)
+uint64_t pthread_cputime(pthread_t thread)
 {
-	int retval = 0;
+	uint64_t ns;
 	unsigned long flags = interrupt_disable();
 
-	if (mutex->lock == 1) {
-		mutex->lock = 0;
-		TAILQ_INSERT_TAIL(&pthread_current->mutex_queue, mutex, link);
-		mutex->owner = pthread_current;
-		mutex->recursive_count = 1;
-	} else if (mutex->type == PTHREAD_MUTEX_RECURSIVE_NP &&
-		   mutex->owner == pthread_current) {
-		mutex->recursive_count++;
+	ns = thread->runtime;
+	if (pthread_running(thread))
+		ns += timekeeping_ns() - thread->exec_start;
+	interrupt_enable(flags);
+
+	return ns;
+}
+
+/*
+ * The idle thread of CPU 0 is -1, pthreads[i] is -2 - i, and the idle thread
+ * of CPU n is -1 - CONFIG_PTHREAD_MAX_NUM - n.
+ */
+int pthread_getcpuclockid(pthread_t thread, clockid_t *clock_id)
+{
+	int cpu;
+
+	if (pthread_is_idle(thread)) {
+		cpu = thread - pthread_idle;
+		if (cpu == 0)
+			*clock_id = (clockid_t)-1;
+		else
+			*clock_id = (clockid_t)(-1 - CONFIG_PTHREAD_MAX_NUM -
+						cpu);
 	} else {
-		retval = EBUSY;
+		*clock_id = (clockid_t)(-2 - (thread - pthreads));
 	}
-	interrupt_enable(flags);
 
-	return retval;
+	return 0;
 }
 
-int pthread_mutex_unlock(pthread_mutex_t *mutex)
+pthread_t pthread_cpuclock_thread(clockid_t clock_id)
 {
-	unsigned long flags = interrupt_disable();
+	int i = -2 - (int)clock_id;
+
+	if (clock_id == CLOCK_THREAD_CPUTIME_ID)
+		return pthread_current;
+	if ((int)clock_id == -1)
+		return &pthread_idle[0];
+#if CONFIG_SMP
+	if (i >= CONFIG_PTHREAD_MAX_NUM) {
+		i -= CONFIG_PTHREAD_MAX_NUM - 1;
+		if ((unsigned int)i >= nr_cpus || !cpus[i].online)
+			return NULL;
+		return &pthread_idle[i];
+	}
+#endif
+	if (i < 0 || i >= CONFIG_PTHREAD_MAX_NUM ||
+	    pthreads[i].state == PTHREAD_STATE_NONE)
+		return NULL;
 
-	if (--mutex->recursive_count == 0) {
-		struct pthread *target = NULL;
+	return &pthreads[i];
+}
 
-		TAILQ_REMOVE(&pthread_current->mutex_queue, mutex, link);
-		mutex->owner = NULL;
-		if (mutex->lock != 0) {
-			struct wait *w;
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize,
+			   const cpu_set_t *cpuset)
+{
+#if CONFIG_SMP
+	unsigned long flags;
+#endif
 
-			TAILQ_FOREACH(w, &mutex->wq, link) {
-				if (!target ||
-				    target->effective_priority < w->thread->effective_priority) {
-					target = w->thread;
-				}
+	if (cpusetsize < sizeof(*cpuset) ||
+	    !(cpuset->bits & cpu_online_mask()))
+		return EINVAL;
+#if CONFIG_SMP
+	flags = interrupt_disable();
+	thread->affinity = cpuset->bits;
+	if (!(thread->affinity & (1UL << thread->cpu))) {
+		/* The running thread is migrated when it is switched out. */
+		if (thread == pthread_current) {
+			schedule();
+		} else if (pthread_running(thread)) {
+			if (cpus[thread->cpu].next) {
+				cpus[thread->cpu].next = NULL;
+				smp_send_reschedule(thread->cpu);
 			}
+		} else if (!TAILQ_ENTRY_EMPTY(&thread->link)) {
+			run_queue_migrate(thread);
 		}
-		mutex->lock = 1;
-		__pthread_setschedprio(pthread_current);
-		if (target)
-			__pthread_set_running(target);
-		schedule();
 	}
 	interrupt_enable(flags);
+#else
+	(void)thread;
+#endif
 
 	return 0;
 }
 
-int pthread_cond_init(pthread_cond_t *cond, pthread_condattr_t *attr)
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize,
+			   cpu_set_t *cpuset)
 {
-	TAILQ_INIT(&cond->wq);
-	(void)attr;
+	if (cpusetsize < sizeof(*cpuset))
+		return EINVAL;
+#if CONFIG_SMP
+	cpuset->bits = thread->affinity & cpu_online_mask();
+#else
+	(void)thread;
+	cpuset->bits = cpu_online_mask();
+#endif
 
 	return 0;
 }
 
-int pthread_cond_destroy(pthread_cond_t *cond)
+int sched_getcpu(void)
 {
-	(void)cond;
-
-	return 0;
+	return smp_processor_id();
 }
 
-int pthread_cond_signal(pthread_cond_t *cond)
+#if CONFIG_RR
+/* Returns true if the timeslice of the thread runs out. */
+static bool pthread_charge(pthread_t thread, unsigned long n)
 {
-	unsigned long flags;
-	struct wait *w, *target = NULL;
-
-	flags = interrupt_disable();
-	TAILQ_FOREACH(w, &cond->wq, link) {
-		if (!target ||
-		    target->thread->effective_priority < w->thread->effective_priority) {
-			target = w;
-		}
-	}
-	if (target) {
-		TAILQ_REMOVE(&cond->wq, target, link);
-		TAILQ_ENTRY_INIT(&target->link);
-		wake_up(target->thread);
+	if (thread->timeslice > n) {
+		thread->timeslice -= n;
+		return false;
 	}
-	interrupt_enable(flags);
+	thread->timeslice = 0;
 
-	return 0;
+	return true;
 }
 
-int pthread_cond_broadcast(pthread_cond_t *cond)
+/* Only the boot CPU ticks, so it charges the threads of the other CPUs too. */
+void pthread_tick(unsigned long n)
 {
-	unsigned long flags;
-	struct wait *w;
+#if CONFIG_SMP
+	struct cpu *cpu;
+	unsigned int i;
 
-	flags = interrupt_disable();
-	if (!TAILQ_EMPTY(&cond->wq)) {
-		while ((w = TAILQ_FIRST(&cond->wq))) {
-			TAILQ_REMOVE(&cond->wq, w, link);
-			TAILQ_ENTRY_INIT(&w->link);
-			__pthread_set_running(w->thread);
+	for (i = 0; i < nr_cpus; ++i) {
+		cpu = &cpus[i];
+		if (i == smp_processor_id()) {
+			if (pthread_charge(cpu->current, n))
+				pthread_next = NULL;
+		} else if (cpu->online && !pthread_is_idle(cpu->current) &&
+			   pthread_charge(cpu->current, n) && cpu->next) {
+			cpu->next = NULL;
+			smp_send_reschedule(i);
 		}
-		schedule();
 	}
-	interrupt_enable(flags);
+#else
+	if (pthread_charge(pthread_current, n))
+		pthread_next = NULL;
+#endif
+}
+
+#if CONFIG_SMP
+bool pthread_tick_needed(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_cpus; ++i) {
+		if (i != smp_processor_id() && cpus[i].online &&
+		    !pthread_is_idle(cpus[i].current))
+			return true;
+	}
+
+	return false;
+}
+#endif
+#endif
+
+/*
+ * Sleeps until woken up, or until the absolute CLOCK_REALTIME time abstime if
+ * it isn't NULL. The state of the current thread must have been set to
+ * PTHREAD_STATE_SLEEPING.
+ */
+static int __pthread_sleep(const struct timespec *abstime)
+{
+	if (!abstime) {
+		schedule();
+		return 0;
+	}
+	if (schedule_hrtimeout(timekeeping_abs_ns(CLOCK_REALTIME,
+						  abstime)) <= 0)
+		return ETIMEDOUT;
+
+	return 0;
+}
+
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
+{
+	wait_queue_init(&mutex->wq);
+	if (attr) {
+		mutex->type = attr->type;
+		mutex->protocol = attr->protocol;
+		mutex->prioceiling = attr->prioceiling;
+	} else {
+		mutex->type = PTHREAD_MUTEX_FAST_NP;
+		mutex->protocol = PTHREAD_PRIO_INHERIT;
+		mutex->prioceiling = SCHED_RR_PRIORITY_MAX;
+	}
+	mutex->recursive_count = 0;
+	mutex->priority = mutex_priority(mutex);
+	mutex->lock = mutex_lock_word(mutex, NULL);
+
+	return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t *mutex)
+{
+	(void)mutex;
+	assert(wait_queue_empty(&mutex->wq));
+
+	return 0;
+}
+
+static inline bool pthread_mutex_fast_lock(pthread_mutex_t *mutex)
+{
+	return cmpxchg(&mutex->lock, 0, (unsigned long)pthread_current) == 0;
+}
+
+static inline bool pthread_mutex_fast_unlock(pthread_mutex_t *mutex)
+{
+	return cmpxchg(&mutex->lock, (unsigned long)pthread_current, 0) ==
+		(unsigned long)pthread_current;
+}
+
+/*
+ * The mutex must be free, and the interrupts must be disabled. The plain store
+ * is safe as the fast paths only succeed on a lock word without
+ * MUTEX_WAITERS, which is set whenever the mutex is free here, or is handed
+ * over by its owner.
+ */
+static void __pthread_mutex_acquire(pthread_mutex_t *mutex, pthread_t thread)
+{
+	mutex->recursive_count = 1;
+	mutex->lock = mutex_lock_word(mutex, thread);
+	if (mutex->lock & MUTEX_WAITERS) {
+		mutex_queue_insert(thread, mutex);
+		if (mutex->priority > thread->effective_priority)
+			__pthread_setschedprio(thread);
+	}
+}
+
+/* Queues w of a thread, which is about to sleep, on the mutex. */
+static void __pthread_mutex_enqueue(pthread_mutex_t *mutex, struct wait *w)
+{
+	unsigned long old;
+	pthread_t owner;
+
+	wait_queue_enqueue(&mutex->wq, w);
+	w->thread->sleep_on = mutex;
+	w->thread->sleep_wait = w;
+	/*
+	 * The owner may unlock it on the fast path on another CPU until the bit
+	 * is set, so the owner is the one the bit is set on. If it is NULL, the
+	 * waiter acquires the mutex at once in __pthread_mutex_wait().
+	 */
+	old = atomic_fetch_or(MUTEX_WAITERS, &mutex->lock);
+	owner = (pthread_t)(old & ~MUTEX_WAITERS);
+	if (!(old & MUTEX_WAITERS) && owner)
+		mutex_queue_insert(owner, mutex);
+	__pthread_spread(w->thread);
+}
+
+/*
+ * Takes w of the current thread, which has timed out, off the owned mutex. The
+ * owner can't change, as MUTEX_WAITERS is still set.
+ */
+static void __pthread_mutex_cancel(pthread_mutex_t *mutex, struct wait *w)
+{
+	pthread_t owner = mutex_owner(mutex);
+
+	pthread_current->sleep_on = NULL;
+	wait_queue_dequeue(&mutex->wq, w);
+	mutex->priority = mutex_priority(mutex);
+	TAILQ_REMOVE(&owner->mutex_queue, mutex, link);
+	mutex->lock = mutex_lock_word(mutex, owner);
+	if (mutex->lock & MUTEX_WAITERS)
+		mutex_queue_insert(owner, mutex);
+	__pthread_setschedprio(owner);
+}
+
+/*
+ * Sleeps on the mutex with w, which has been queued, until acquiring it, or
+ * until it is handed over by __pthread_mutex_unlock(), which dequeues w, or
+ * until the absolute CLOCK_REALTIME time abstime if it isn't NULL.
+ */
+static int __pthread_mutex_wait(pthread_mutex_t *mutex, struct wait *w,
+				const struct timespec *abstime)
+{
+	while (!TAILQ_ENTRY_EMPTY(&w->link) && mutex_owner(mutex)) {
+		pthread_current->state = PTHREAD_STATE_SLEEPING;
+		if (__pthread_sleep(abstime) == ETIMEDOUT &&
+		    !TAILQ_ENTRY_EMPTY(&w->link) && mutex_owner(mutex)) {
+			__pthread_mutex_cancel(mutex, w);
+			return ETIMEDOUT;
+		}
+	}
+	if (TAILQ_ENTRY_EMPTY(&w->link))
+		return 0;
+	pthread_current->sleep_on = NULL;
+	wait_queue_dequeue(&mutex->wq, w);
+	mutex->priority = mutex_priority(mutex);
+	__pthread_mutex_acquire(mutex, pthread_current);
+
+	return 0;
+}
+
+static int __pthread_mutex_lock(pthread_mutex_t *mutex,
+				const struct timespec *abstime)
+{
+	struct wait w;
+
+	w.thread = pthread_current;
+	__pthread_mutex_enqueue(mutex, &w);
+
+	return __pthread_mutex_wait(mutex, &w, abstime);
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t *mutex,
+			    const struct timespec *abstime)
+{
+	int retval = 0;
+	unsigned long flags;
+
+	assert(!in_irq);
+
+	if (pthread_mutex_fast_lock(mutex)) {
+		mutex->recursive_count = 1;
+	} else if (mutex->type == PTHREAD_MUTEX_RECURSIVE_NP &&
+		   mutex_owner(mutex) == pthread_current) {
+		mutex->recursive_count++;
+	} else if (mutex->protocol == PTHREAD_PRIO_PROTECT &&
+		   pthread_current->priority > mutex->prioceiling) {
+		retval = EINVAL;
+	} else {
+		flags = interrupt_disable();
+		retval = __pthread_mutex_lock(mutex, abstime);
+		interrupt_enable(flags);
+	}
+
+	return retval;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+	return pthread_mutex_timedlock(mutex, NULL);
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+	int retval = 0;
+	unsigned long flags;
+
+	if (pthread_mutex_fast_lock(mutex)) {
+		mutex->recursive_count = 1;
+	} else if (mutex_owner(mutex) == pthread_current) {
+		if (mutex->type == PTHREAD_MUTEX_RECURSIVE_NP)
+			mutex->recursive_count++;
+		else
+			retval = EBUSY;
+	} else if (mutex->protocol == PTHREAD_PRIO_PROTECT &&
+		   pthread_current->priority > mutex->prioceiling) {
+		retval = EINVAL;
+	} else {
+		flags = interrupt_disable();
+		/* Without MUTEX_WAITERS, it may be taken on another CPU. */
+		if (pthread_mutex_fast_lock(mutex))
+			mutex->recursive_count = 1;
+		else if (mutex_owner(mutex))
+			retval = EBUSY;
+		else
+			__pthread_mutex_acquire(mutex, pthread_current);
+		interrupt_enable(flags);
+	}
+
+	return retval;
+}
+
+/* Returns true if a waiter was woken up, and a reschedule is needed. */
+static bool __pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+	unsigned long flags;
+	struct wait *w;
+
+	if (--mutex->recursive_count > 0 || pthread_mutex_fast_unlock(mutex))
+		return false;
+
+	flags = interrupt_disable();
+	/* The last waiter may have timed out and cleared MUTEX_WAITERS. */
+	if (pthread_mutex_fast_unlock(mutex)) {
+		interrupt_enable(flags);
+		return false;
+	}
+	TAILQ_REMOVE(&pthread_current->mutex_queue, mutex, link);
+	w = wait_queue_peek(&mutex->wq);
+	if (w && mutex->type == PTHREAD_MUTEX_HANDOFF_NP) {
+		wait_queue_dequeue(&mutex->wq, w);
+		w->thread->sleep_on = NULL;
+		mutex->priority = mutex_priority(mutex);
+		__pthread_mutex_acquire(mutex, w->thread);
+	} else {
+		mutex->lock = mutex_lock_word(mutex, NULL);
+	}
+	__pthread_setschedprio(pthread_current);
+	if (w)
+		__pthread_set_running(w->thread);
+	interrupt_enable(flags);
+
+	return true;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+	if (__pthread_mutex_unlock(mutex))
+		schedule();
+
+	return 0;
+}
+
+int pthread_mutex_getprioceiling(const pthread_mutex_t *mutex,
+				 int *prioceiling)
+{
+	if (mutex->protocol != PTHREAD_PRIO_PROTECT)
+		return EINVAL;
+	*prioceiling = mutex->prioceiling;
+
+	return 0;
+}
+
+int pthread_mutex_setprioceiling(pthread_mutex_t *mutex, int prioceiling,
+				 int *old_ceiling)
+{
+	int retval;
+	unsigned long flags;
+
+	if (mutex->protocol != PTHREAD_PRIO_PROTECT ||
+	    prioceiling < SCHED_RR_PRIORITY_MIN ||
+	    prioceiling > SCHED_RR_PRIORITY_MAX)
+		return EINVAL;
+	retval = pthread_mutex_lock(mutex);
+	if (retval)
+		return retval;
+	flags = interrupt_disable();
+	if (old_ceiling)
+		*old_ceiling = mutex->prioceiling;
+	mutex->prioceiling = prioceiling;
+	mutex->priority = prioceiling;
+	TAILQ_REMOVE(&pthread_current->mutex_queue, mutex, link);
+	mutex_queue_insert(pthread_current, mutex);
+	__pthread_setschedprio(pthread_current);
+	interrupt_enable(flags);
+
+	return pthread_mutex_unlock(mutex);
+}
+
+int pthread_cond_init(pthread_cond_t *cond, pthread_condattr_t *attr)
+{
+	wait_queue_init(&cond->wq);
+	cond->mutex = NULL;
+	(void)attr;
+
+	return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+	(void)cond;
+
+	return 0;
+}
+
+/*
+ * Instead of being woken up only to block on the mutex again, a waiter is
+ * moved onto the wait queue of the mutex, and sleeps on until it can take the
+ * mutex.
+ */
+static void __pthread_cond_requeue(pthread_cond_t *cond, struct wait *w)
+{
+	wait_queue_dequeue(&cond->wq, w);
+	__pthread_mutex_enqueue(cond->mutex, w);
+}
+
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+	unsigned long flags;
+	struct wait *w;
+
+	flags = interrupt_disable();
+	w = wait_queue_peek(&cond->wq);
+	if (w) {
+		if (mutex_owner(cond->mutex)) {
+			__pthread_cond_requeue(cond, w);
+		} else {
+			wait_queue_dequeue(&cond->wq, w);
+			wake_up(w->thread);
+		}
+	}
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+	unsigned long flags;
+	struct wait *w;
+
+	flags = interrupt_disable();
+	if (!wait_queue_empty(&cond->wq)) {
+		while ((w = wait_queue_peek(&cond->wq)))
+			__pthread_cond_requeue(cond, w);
+		if (!mutex_owner(cond->mutex))
+			wake_up(wait_queue_peek(&cond->mutex->wq)->thread);
+		else
+			schedule();
+	}
+	interrupt_enable(flags);
 
 	return 0;
 }
@@ -637,32 +1402,509 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
 
 	w.thread = pthread_self();
 	flags = interrupt_disable();
-	TAILQ_INSERT_TAIL(&cond->wq, &w, link);
+	wait_queue_enqueue(&cond->wq, &w);
+	cond->mutex = mutex;
 	w.thread->state = PTHREAD_STATE_SLEEPING;
-	pthread_mutex_unlock(mutex);
-	if (abstime) {
-		struct timespec now;
-		unsigned long delta;
-
-		clock_gettime(CLOCK_REALTIME, &now);
-		if (abstime->tv_sec > now.tv_sec ||
-		    (abstime->tv_sec == now.tv_sec &&
-		     abstime->tv_nsec > now.tv_nsec)) {
-			delta = (abstime->tv_sec - now.tv_sec) * TICKS_PER_SEC +
-				(abstime->tv_nsec - now.tv_nsec) / NSECS_PER_TICK;
-			if (delta == 0)
-				delta = 1;
-			if (schedule_timeout(delta) <= 0)
-				retval = ETIMEDOUT;
+	__pthread_mutex_unlock(mutex);
+	retval = __pthread_sleep(abstime);
+	if (pthread_current->sleep_on == mutex) {
+		retval = 0;
+		__pthread_mutex_wait(mutex, &w, NULL);
+	} else if (mutex_owner(mutex) == pthread_current) {
+		retval = 0;  /* handed over after the requeue */
+	} else {
+		if (!TAILQ_ENTRY_EMPTY(&w.link))
+			wait_queue_dequeue(&cond->wq, &w);
+		pthread_mutex_lock(mutex);
+	}
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock,
+			const pthread_rwlockattr_t *attr)
+{
+	pthread_mutex_init(&rwlock->mutex, NULL);
+	rwlock->kind = attr ? attr->kind : PTHREAD_RWLOCK_DEFAULT_NP;
+	rwlock->readers = 0;
+	rwlock->readers_waiting = 0;
+	rwlock->writers_waiting = 0;
+
+	return 0;
+}
+
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock)
+{
+	(void)rwlock;
+	assert(rwlock->readers == 0 && rwlock->mutex.lock == 0);
+	assert(wait_queue_empty(&rwlock->mutex.wq));
+
+	return 0;
+}
+
+struct rwlock_wait {
+	struct wait	w;
+	bool		write;
+};
+
+static inline bool __pthread_rwlock_can_read(pthread_rwlock_t *rwlock)
+{
+	if (mutex_owner(&rwlock->mutex))
+		return false;
+
+	return rwlock->kind == PTHREAD_RWLOCK_PREFER_READER_NP ||
+	       rwlock->writers_waiting == 0;
+}
+
+static inline bool __pthread_rwlock_can_write(pthread_rwlock_t *rwlock)
+{
+	return !mutex_owner(&rwlock->mutex) && rwlock->readers == 0;
+}
+
+/* Sleeps until the lock is granted by __pthread_rwlock_release(). */
+static void __pthread_rwlock_wait(pthread_rwlock_t *rwlock, bool write)
+{
+	struct pthread_mutex *mutex = &rwlock->mutex;
+	struct rwlock_wait rw;
+	unsigned long old;
+	pthread_t owner;
+
+	rw.w.thread = pthread_current;
+	rw.write = write;
+	wait_queue_enqueue(&mutex->wq, &rw.w);
+	if (write)
+		rwlock->writers_waiting++;
+	else
+		rwlock->readers_waiting++;
+	pthread_current->sleep_on = mutex;
+	pthread_current->sleep_wait = &rw.w;
+	if (mutex_owner(mutex)) {
+		old = atomic_fetch_or(MUTEX_WAITERS, &mutex->lock);
+		owner = (pthread_t)(old & ~MUTEX_WAITERS);
+		if (owner && !(old & MUTEX_WAITERS))
+			mutex_queue_insert(owner, mutex);
+	}
+	__pthread_spread(pthread_current);
+	do {
+		pthread_current->state = PTHREAD_STATE_SLEEPING;
+		schedule();
+	} while (!TAILQ_ENTRY_EMPTY(&rw.w.link));
+}
+
+static void __pthread_rwlock_grant(pthread_rwlock_t *rwlock, struct wait *w)
+{
+	struct pthread_mutex *mutex = &rwlock->mutex;
+
+	wait_queue_dequeue(&mutex->wq, w);
+	w->thread->sleep_on = NULL;
+	if (container_of(w, struct rwlock_wait, w)->write) {
+		rwlock->writers_waiting--;
+		mutex->priority = mutex_priority(mutex);
+		__pthread_mutex_acquire(mutex, w->thread);
+	} else {
+		rwlock->readers_waiting--;
+		rwlock->readers++;
+	}
+	__pthread_set_running(w->thread);
+}
+
+/*
+ * Hands the free lock over to either all the waiting readers, or the waiting
+ * writer with the highest priority, depending on the preference. Returns true
+ * if any waiter was woken up.
+ */
+static bool __pthread_rwlock_release(pthread_rwlock_t *rwlock)
+{
+	struct wait_queue *wq = &rwlock->mutex.wq;
+	struct wait *w, *next;
+	bool read;
+	int i;
+
+	if (rwlock->readers_waiting > 0 &&
+	    (rwlock->kind == PTHREAD_RWLOCK_PREFER_READER_NP ||
+	     rwlock->writers_waiting == 0)) {
+		read = true;
+	} else if (rwlock->writers_waiting > 0) {
+		read = false;
+	} else {
+		return false;
+	}
+
+	for (i = SCHED_RR_PRIORITY_MAX; i >= SCHED_RR_PRIORITY_MIN; --i) {
+		for (w = TAILQ_FIRST(&wq->level[i]); w; w = next) {
+			next = TAILQ_NEXT(w, link);
+			if (container_of(w, struct rwlock_wait, w)->write) {
+				if (!read) {
+					__pthread_rwlock_grant(rwlock, w);
+					return true;
+				}
+			} else if (read) {
+				__pthread_rwlock_grant(rwlock, w);
+			}
+		}
+	}
+	rwlock->mutex.priority = mutex_priority(&rwlock->mutex);
+
+	return true;
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+	int retval = 0;
+	unsigned long flags;
+
+	assert(!in_irq);
+
+	flags = interrupt_disable();
+	if (mutex_owner(&rwlock->mutex) == pthread_current)
+		retval = EDEADLK;
+	else if (__pthread_rwlock_can_read(rwlock))
+		rwlock->readers++;
+	else
+		__pthread_rwlock_wait(rwlock, false);
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock)
+{
+	int retval = 0;
+	unsigned long flags = interrupt_disable();
+
+	if (__pthread_rwlock_can_read(rwlock))
+		rwlock->readers++;
+	else
+		retval = EBUSY;
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+	int retval = 0;
+	unsigned long flags;
+
+	assert(!in_irq);
+
+	flags = interrupt_disable();
+	if (mutex_owner(&rwlock->mutex) == pthread_current)
+		retval = EDEADLK;
+	else if (__pthread_rwlock_can_write(rwlock))
+		__pthread_mutex_acquire(&rwlock->mutex, pthread_current);
+	else
+		__pthread_rwlock_wait(rwlock, true);
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+	int retval = 0;
+	unsigned long flags = interrupt_disable();
+
+	if (__pthread_rwlock_can_write(rwlock))
+		__pthread_mutex_acquire(&rwlock->mutex, pthread_current);
+	else
+		retval = EBUSY;
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+	struct pthread_mutex *mutex = &rwlock->mutex;
+	unsigned long flags = interrupt_disable();
+
+	if (mutex_owner(mutex) == pthread_current) {
+		if (mutex->lock & MUTEX_WAITERS) {
+			TAILQ_REMOVE(&pthread_current->mutex_queue, mutex,
+				     link);
+		}
+		mutex->lock = 0;
+		__pthread_setschedprio(pthread_current);
+		__pthread_rwlock_release(rwlock);
+		schedule();
+	} else {
+		assert(rwlock->readers > 0);
+		if (--rwlock->readers == 0 && __pthread_rwlock_release(rwlock))
+			schedule();
+	}
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+int sem_init(sem_t *sem, int pshared, unsigned int value)
+{
+	(void)pshared;
+	sem->value = value;
+	wait_queue_init(&sem->wq);
+
+	return 0;
+}
+
+int sem_destroy(sem_t *sem)
+{
+	(void)sem;
+	assert(wait_queue_empty(&sem->wq));
+
+	return 0;
+}
+
+int sem_trywait(sem_t *sem)
+{
+	int retval = 0;
+	unsigned long flags = interrupt_disable();
+
+	if (sem->value > 0) {
+		sem->value--;
+	} else {
+		errno = EAGAIN;
+		retval = -1;
+	}
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+int sem_timedwait(sem_t *sem, const struct timespec *abstime)
+{
+	int retval = 0;
+	unsigned long flags;
+	struct wait w;
+
+	assert(!in_irq);
+
+	flags = interrupt_disable();
+	if (sem->value > 0) {
+		sem->value--;
+	} else {
+		w.thread = pthread_current;
+		wait_queue_enqueue(&sem->wq, &w);
+		do {
+			pthread_current->state = PTHREAD_STATE_SLEEPING;
+			retval = __pthread_sleep(abstime);
+		} while (retval == 0 && !TAILQ_ENTRY_EMPTY(&w.link));
+		if (TAILQ_ENTRY_EMPTY(&w.link)) {
+			retval = 0;
 		} else {
-			retval = ETIMEDOUT;
+			wait_queue_dequeue(&sem->wq, &w);
+			errno = retval;
+			retval = -1;
 		}
+	}
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+/* The count is handed over to the top waiter directly, if there is one. */
+int sem_post(sem_t *sem)
+{
+	unsigned long flags = interrupt_disable();
+	struct wait *w = wait_queue_peek(&sem->wq);
+
+	if (w) {
+		wait_queue_dequeue(&sem->wq, w);
+		wake_up(w->thread);
 	} else {
+		sem->value++;
+	}
+	interrupt_enable(flags);
+
+	return 0;
+}
+
+int sem_getvalue(sem_t *sem, int *sval)
+{
+	*sval = sem->value;
+
+	return 0;
+}
+
+int event_init(event_t *event, uint32_t flags)
+{
+	event->flags = flags;
+	wait_queue_init(&event->wq);
+
+	return 0;
+}
+
+int event_destroy(event_t *event)
+{
+	(void)event;
+	assert(wait_queue_empty(&event->wq));
+
+	return 0;
+}
+
+struct event_wait {
+	struct wait	w;
+	uint32_t	mask;
+	int		options;
+	uint32_t	flags;  /* which satisfied the wait */
+};
+
+static inline bool event_satisfied(uint32_t flags, uint32_t mask, int options)
+{
+	if (options & EVENT_WAIT_ALL)
+		return (flags & mask) == mask;
+
+	return (flags & mask) != 0;
+}
+
+/*
+ * Waits until any or all of the flags in mask are set, or until the absolute
+ * CLOCK_REALTIME time abstime if it isn't NULL. The flags which satisfied the
+ * wait are stored in flags if it isn't NULL.
+ */
+int event_timedwait(event_t *event, uint32_t mask, int options,
+		    uint32_t *flags, const struct timespec *abstime)
+{
+	int retval = 0;
+	unsigned long irq_flags;
+	struct event_wait ew;
+
+	assert(!in_irq);
+	if (mask == 0)
+		return EINVAL;
+
+	irq_flags = interrupt_disable();
+	if (event_satisfied(event->flags, mask, options)) {
+		ew.flags = event->flags;
+		if (options & EVENT_CLEAR)
+			event->flags &= ~mask;
+	} else {
+		ew.w.thread = pthread_current;
+		ew.mask = mask;
+		ew.options = options;
+		wait_queue_enqueue(&event->wq, &ew.w);
+		do {
+			pthread_current->state = PTHREAD_STATE_SLEEPING;
+			retval = __pthread_sleep(abstime);
+		} while (retval == 0 && !TAILQ_ENTRY_EMPTY(&ew.w.link));
+		if (TAILQ_ENTRY_EMPTY(&ew.w.link))
+			retval = 0;
+		else
+			wait_queue_dequeue(&event->wq, &ew.w);
+	}
+	if (retval == 0 && flags)
+		*flags = ew.flags;
+	interrupt_enable(irq_flags);
+
+	return retval;
+}
+
+/*
+ * Sets the flags in mask, and wakes up all the waiters satisfied in one pass,
+ * from the highest priority down. It is safe to call it in the interrupt
+ * context. Returns the flags left set.
+ */
+uint32_t event_set(event_t *event, uint32_t mask)
+{
+	struct event_wait *ew;
+	struct wait *w, *next;
+	bool woken = false;
+	uint32_t retval;
+	int i;
+	unsigned long flags = interrupt_disable();
+
+	event->flags |= mask;
+	for (i = SCHED_RR_PRIORITY_MAX;
+	     i >= SCHED_RR_PRIORITY_MIN && event->flags; --i) {
+		for (w = TAILQ_FIRST(&event->wq.level[i]); w; w = next) {
+			next = TAILQ_NEXT(w, link);
+			ew = container_of(w, struct event_wait, w);
+			if (!event_satisfied(event->flags, ew->mask,
+					     ew->options))
+				continue;
+			ew->flags = event->flags;
+			if (ew->options & EVENT_CLEAR)
+				event->flags &= ~ew->mask;
+			wait_queue_dequeue(&event->wq, w);
+			__pthread_set_running(w->thread);
+			woken = true;
+		}
+	}
+	retval = event->flags;
+	if (woken)
 		schedule();
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+uint32_t event_clear(event_t *event, uint32_t mask)
+{
+	uint32_t retval;
+	unsigned long flags = interrupt_disable();
+
+	retval = event->flags;
+	event->flags &= ~mask;
+	interrupt_enable(flags);
+
+	return retval;
+}
+
+uint32_t event_get(event_t *event)
+{
+	return event->flags;
+}
+
+int pthread_barrier_init(pthread_barrier_t *barrier,
+			 const pthread_barrierattr_t *attr, unsigned int count)
+{
+	(void)attr;
+	if (count == 0)
+		return EINVAL;
+	barrier->count = count;
+	barrier->waiting = 0;
+	TAILQ_INIT(&barrier->wl);
+
+	return 0;
+}
+
+int pthread_barrier_destroy(pthread_barrier_t *barrier)
+{
+	(void)barrier;
+	assert(barrier->waiting == 0);
+
+	return 0;
+}
+
+int pthread_barrier_wait(pthread_barrier_t *barrier)
+{
+	int retval = 0;
+	unsigned long flags;
+	struct wait *w;
+
+	assert(!in_irq);
+
+	flags = interrupt_disable();
+	if (++barrier->waiting == barrier->count) {
+		barrier->waiting = 0;
+		while ((w = TAILQ_FIRST(&barrier->wl))) {
+			TAILQ_REMOVE(&barrier->wl, w, link);
+			TAILQ_ENTRY_INIT(&w->link);
+			__pthread_set_running(w->thread);
+		}
+		schedule();
+		retval = PTHREAD_BARRIER_SERIAL_THREAD;
+	} else {
+		struct wait self;
+
+		self.thread = pthread_current;
+		TAILQ_INSERT_TAIL(&barrier->wl, &self, link);
+		do {
+			pthread_current->state = PTHREAD_STATE_SLEEPING;
+			schedule();
+		} while (!TAILQ_ENTRY_EMPTY(&self.link));
 	}
-	pthread_mutex_lock(mutex);
-	if (!TAILQ_ENTRY_EMPTY(&w.link))
-		TAILQ_REMOVE(&cond->wq, &w, link);
 	interrupt_enable(flags);
 
 	return retval;
@@ -671,8 +1913,7 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
 void pthread_foreach(void (*callback)(pthread_t ))
 {
 	size_t i;
-	unsigned long flags = interrupt_disable();
-
+	preempt_lock(&pthreads_lock);
 	for (i = 0; i < ARRAY_SIZE(pthreads); ++i) {
 		switch (pthreads[i].state) {
 		case PTHREAD_STATE_NONE:
@@ -683,7 +1924,9 @@ void pthread_foreach(void (*callback)(pthread_t ))
 		}
 		callback(&pthreads[i]);
 	}
-	callback(&pthread_idle);
-
-	interrupt_enable(flags);
+	for (i = 0; i < ARRAY_SIZE(pthread_idle); ++i) {
+		if (pthread_idle[i].state != PTHREAD_STATE_NONE)
+			callback(&pthread_idle[i]);
+	}
+	preempt_unlock(&pthreads_lock);
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 Changli Gao <xiaosuo@gmail.com>
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <smp.h>
+#include <pthread.h>
+#include <spinlock.h>
+#include <idle.h>
+#include <stddef.h>
+
+_Static_assert(offsetof(struct cpu, current) == CPU_CURRENT, "CPU_CURRENT");
+_Static_assert(offsetof(struct cpu, next) == CPU_NEXT, "CPU_NEXT");
+_Static_assert(offsetof(struct cpu, preempt) == CPU_PREEMPT, "CPU_PREEMPT");
+
+struct cpu cpus[NR_CPUS];
+unsigned int nr_cpus = 1;
+
+/* Held by the boot CPU until it enables the interrupts in main(). */
+static spinlock_t big_lock = { 1 << SPINLOCK_TICKET_SHIFT };
+
+void big_lock_acquire(void)
+{
+	spin_lock(&big_lock);
+}
+
+void big_lock_release(void)
+{
+	spin_unlock(&big_lock);
+}
+
+void smp_init(void)
+{
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < NR_CPUS; ++cpu) {
+		cpus[cpu].self = &cpus[cpu];
+		cpus[cpu].id = cpu;
+	}
+	cpus[0].online = true;
+}
+
+unsigned long cpu_online_mask(void)
+{
+	unsigned long mask = 0;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < nr_cpus; ++cpu) {
+		if (cpus[cpu].online)
+			mask |= 1UL << cpu;
+	}
+
+	return mask;
+}
+
+void smp_cpu_start(unsigned int cpu, void *stack_addr)
+{
+	big_lock_acquire();
+	pthread_init_cpu(cpu, stack_addr);
+	cpus[cpu].online = true;
+	arch_enable_interrupt();
+	pthread_yield();
+	cpu_idle();
+}
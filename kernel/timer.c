@@ -27,17 +27,21 @@
 #include <pthread.h>
 #include <interrupt.h>
 #include <kernel.h>
+#include <clocksource.h>
+#include <hrtimer.h>
+#include <seqlock.h>
+#include <stdio.h>
 
 #include <sys/param.h>
 
-#ifndef CONFIG_TIMER_MAX_NUM
-#define CONFIG_TIMER_MAX_NUM 32
-#endif
-
 #ifndef CONFIG_TZ
 #define CONFIG_TZ (-480)
 #endif
 
+#ifndef CONFIG_TIMER_SOFTIRQ_BUDGET
+#define CONFIG_TIMER_SOFTIRQ_BUDGET 16
+#endif
+
 volatile unsigned long ticks = 0;
 
 struct wall_clock wall_clock = {
@@ -46,118 +50,225 @@ struct wall_clock wall_clock = {
 	}
 };
 
-static struct timeval monotonic_clock;
+/*
+ * CLOCK_MONOTONIC is ns at cycle_last plus the cycles read since, scaled by
+ * the clock source, and CLOCK_REALTIME is offset from it. The cycles are
+ * folded into ns once a second, so the scaling never overflows. The
+ * timekeeper is written with the interrupts disabled, and read locklessly
+ * under seq. The wall clock is written under seq too.
+ */
+static struct {
+	seqcount_t		seq;
+	struct clocksource	*cs;
+	uint64_t		cycle_last;
+	uint64_t		ns;
+	uint64_t		offset;
+	unsigned long		fold;  /* the ticks of the next fold */
+} timekeeper = {
+	.cs	= &clocksource_jiffies,
+};
+
+/*
+ * A hierarchical timing wheel: the timers expiring in the next 256 ticks are
+ * hashed by their expiry into the slots of the first level, and the later
+ * ones into the 64 slots of the other levels, which are cascaded down a level
+ * whenever the level below wraps around. base is the next tick to run.
+ * The expired timers wait in the expired list for the timer softirq, and are
+ * still counted in n.
+ */
+enum {
+	TVR_BITS	= 8,
+	TVN_BITS	= 6,
+	TVR_SIZE	= 1 << TVR_BITS,
+	TVN_SIZE	= 1 << TVN_BITS,
+	TVR_MASK	= TVR_SIZE - 1,
+	TVN_MASK	= TVN_SIZE - 1,
+	TVN_NUM		= 4
+};
+
+LIST_HEAD(timer_list, timer);
 
 static struct {
-	struct timer	*heap[CONFIG_TIMER_MAX_NUM];
-	size_t		n;
+	unsigned long		base;
+	unsigned long		n;
+	struct timer_list	expired;
+	struct timer		*running;  /* in the softirq */
+	struct timer_list	tv1[TVR_SIZE];
+	struct timer_list	tvn[TVN_NUM][TVN_SIZE];
 } timer_context;
 
-static void heap_swap(size_t i, size_t j)
+static inline unsigned long tvn_index(int level, unsigned long expires)
 {
-	struct timer *tmp;
-
-	tmp = timer_context.heap[i];
-	timer_context.heap[i] = timer_context.heap[j];
-	timer_context.heap[j] = tmp;
-	timer_context.heap[i]->i = i;
-	timer_context.heap[j]->i = j;
+	return (expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK;
 }
 
-static void heap_pull_up(size_t i)
+static void __timer_add(struct timer *timer)
 {
-	size_t p;
-
-	while (i > 0) {
-		p = (i - 1) / 2;
-		if (!time_before(timer_context.heap[i]->expires,
-				 timer_context.heap[p]->expires)) {
-			break;
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_context.base;
+	struct timer_list *slot;
+	int level;
+
+	if ((long)idx < 0) {
+		slot = &timer_context.tv1[timer_context.base & TVR_MASK];
+	} else if (idx < TVR_SIZE) {
+		slot = &timer_context.tv1[expires & TVR_MASK];
+	} else {
+		for (level = 0; level < TVN_NUM - 1; ++level) {
+			if (idx < 1UL << (TVR_BITS + (level + 1) * TVN_BITS))
+				break;
 		}
-		heap_swap(i, p);
-		i = p;
+		slot = &timer_context.tvn[level][tvn_index(level, expires)];
 	}
+	LIST_INSERT_HEAD(slot, timer, link);
 }
 
-static void heap_push_down(size_t i)
+/*
+ * Rounds expires up within the slack by clearing the low bits in which it
+ * differs from the latest expiry allowed.
+ */
+static unsigned long timer_apply_slack(unsigned long expires,
+				       unsigned long slack)
 {
-	size_t c, smallest;
+	unsigned long limit = expires + slack;
+	unsigned long mask = expires ^ limit;
 
-	assert(i < timer_context.n);
+	if (mask == 0)
+		return expires;
+	mask = (1UL << (fls(mask) - 1)) - 1;
 
-	for (;;) {
-		smallest = i;
-		c = i * 2 + 1;
-		if (c >= timer_context.n)
-			break;
-		if (time_after(timer_context.heap[smallest]->expires,
-			       timer_context.heap[c]->expires)) {
-			smallest = c;
-		}
-		if (++c < timer_context.n) {
-			if (time_after(timer_context.heap[smallest]->expires,
-				       timer_context.heap[c]->expires)) {
-				smallest = c;
-			}
-		}
-		if (i == smallest)
-			break;
-		heap_swap(i, smallest);
-		i = smallest;
-	}
+	return limit & ~mask;
 }
 
-static void heap_adjust(size_t i)
+void timer_add(struct timer *timer)
 {
-	assert(i < timer_context.n);
+	unsigned long flags = interrupt_disable();
 
-	if (i > 0) {
-		size_t p = (i - 1) / 2;
+	timer->expires = timer_apply_slack(timer->expires, timer->slack);
+	__timer_add(timer);
+	timer_context.n++;
+	interrupt_enable(flags);
+}
 
-		if (time_after(timer_context.heap[p]->expires,
-			       timer_context.heap[i]->expires)) {
-			heap_pull_up(i);
-			return;
-		}
-	}
-	heap_push_down(i);
+static void __timer_del(struct timer *timer)
+{
+	LIST_REMOVE(timer, link);
+	timer_context.n--;
 }
 
-void timer_add(struct timer *timer)
+void timer_del(struct timer *timer)
 {
-	size_t i;
 	unsigned long flags = interrupt_disable();
 
-	assert(timer_context.n < ARRAY_SIZE(timer_context.heap));
-
-	i = timer_context.n++;
-	timer_context.heap[i] = timer;
-	timer_context.heap[i]->i = i;
-	heap_pull_up(i);
+	if (!LIST_ENTRY_EMPTY(&timer->link))
+		__timer_del(timer);
+	/* Its function may still run in the softirq on another CPU. */
+	while (timer_context.running == timer && !in_softirq) {
+		interrupt_enable(flags);
+		cpu_relax();
+		flags = interrupt_disable();
+	}
 	interrupt_enable(flags);
 }
 
-static void __timer_delete(struct timer *timer)
+/* Moves the timers of the slot of the level down. Returns the index. */
+static unsigned long timer_cascade(int level)
 {
-	size_t i = timer->i;
+	unsigned long i = tvn_index(level, timer_context.base);
+	struct timer_list *slot = &timer_context.tvn[level][i];
+	struct timer *timer;
 
-	if (i != --timer_context.n) {
-		timer_context.heap[i] = timer_context.heap[timer_context.n];
-		timer_context.heap[i]->i = i;
-		heap_adjust(i);
+	while ((timer = LIST_FIRST(slot))) {
+		LIST_REMOVE(timer, link);
+		__timer_add(timer);
 	}
-	timer->i = TIMER_INVALID_INDEX;
+
+	return i;
 }
 
-void timer_delete(struct timer *timer)
+static void timer_run(unsigned long now)
 {
+	struct timer_list *slot;
+	struct timer *timer;
+	unsigned long i;
+	int level;
+
+	while (timer_context.n > 0 && !time_after(timer_context.base, now)) {
+		i = timer_context.base & TVR_MASK;
+		for (level = 0; i == 0 && level < TVN_NUM; ++level)
+			i = timer_cascade(level);
+		slot = &timer_context.tv1[timer_context.base & TVR_MASK];
+		timer_context.base++;
+		while ((timer = LIST_FIRST(slot))) {
+			if (timer->flags & TIMER_IRQSAFE) {
+				__timer_del(timer);
+				timer->func(timer);
+			} else {
+				LIST_REMOVE(timer, link);
+				LIST_INSERT_HEAD(&timer_context.expired, timer,
+						 link);
+			}
+		}
+	}
+	if (timer_context.n == 0)
+		timer_context.base = now + 1;
+	if (!LIST_EMPTY(&timer_context.expired))
+		raise_softirq(SOFTIRQ_TIMER);
+}
+
+/*
+ * Runs at most CONFIG_TIMER_SOFTIRQ_BUDGET expired timers in a pass, so the
+ * rest of the softirqs and the threads aren't held up by a burst of them.
+ */
+void timer_softirq(void)
+{
+	int budget = CONFIG_TIMER_SOFTIRQ_BUDGET;
+	struct timer *timer;
 	unsigned long flags = interrupt_disable();
 
-	if (timer->i != TIMER_INVALID_INDEX)
-		__timer_delete(timer);
+	while ((timer = LIST_FIRST(&timer_context.expired))) {
+		if (budget-- == 0) {
+			raise_softirq(SOFTIRQ_TIMER);
+			break;
+		}
+		__timer_del(timer);
+		timer_context.running = timer;
+		interrupt_enable(flags);
+		timer->func(timer);
+		flags = interrupt_disable();
+		timer_context.running = NULL;
+	}
 	interrupt_enable(flags);
 }
 
+#if CONFIG_NO_HZ
+/*
+ * Returns the ticks until the earliest timer, or until the first level wraps
+ * around if it has none, and the others may have, but at most max. Returns 0
+ * if the softirq has left expired timers.
+ */
+static unsigned long timer_next(unsigned long max)
+{
+	unsigned long i, n;
+
+	if (timer_context.n == 0)
+		return max;
+	if (!LIST_EMPTY(&timer_context.expired))
+		return 0;
+	for (n = 0; n < max; ++n) {
+		i = (timer_context.base + n) & TVR_MASK;
+		if (!LIST_EMPTY(&timer_context.tv1[i]))
+			break;
+		if (i == TVR_MASK) {
+			n++;
+			break;
+		}
+	}
+
+	return MIN(n + (timer_context.base - ticks), max);
+}
+#endif
+
 struct sched_timer {
 	struct timer	timer;
 	pthread_t	thread;
@@ -174,17 +285,26 @@ static void sched_timeout(struct timer *timer)
 long schedule_timeout(unsigned long timeout)
 {
 	struct sched_timer t;
+	unsigned long expires = ticks + timeout;
 
 	assert(!in_irq);
 
-	t.timer.expires = ticks + timeout;
-	t.timer.func = sched_timeout;
+	timer_init(&t.timer, sched_timeout);
+	/*
+	 * It is on the stack, which is reused as soon as the thread returns,
+	 * maybe woken up on another CPU while the softirq still runs it.
+	 */
+	t.timer.flags = TIMER_IRQSAFE;
+	t.timer.expires = expires;
+	/* like Linux, a long timeout may be deferred by 0.4% */
+	t.timer.slack = MAX(timeout >> 8,
+			    pthread_current->timer_slack / NSECS_PER_TICK);
 	t.thread = pthread_current;
 	timer_add(&t.timer);
 	schedule();
-	timer_delete(&t.timer);
+	timer_del(&t.timer);
 
-	return t.timer.expires - ticks;
+	return expires - ticks;
 }
 
 unsigned int sleep(unsigned int seconds)
@@ -204,74 +324,269 @@ unsigned int sleep(unsigned int seconds)
 int usleep(useconds_t usec)
 {
 	pthread_current->state = PTHREAD_STATE_SLEEPING;
-	schedule_timeout(howmany(usec, USECS_PER_SEC / CONFIG_HZ));
+	schedule_hrtimeout(timekeeping_ns() + (uint64_t)usec * NSECS_PER_USEC);
 
 	return 0;
 }
 
-static void update_timeval(struct timeval *tv)
+static uint64_t __timekeeping_delta(void)
+{
+	struct clocksource *cs = timekeeper.cs;
+
+	return (cs->read() - timekeeper.cycle_last) & cs->mask;
+}
+
+/* Returns the CLOCK_MONOTONIC time in ns. */
+static uint64_t __timekeeping_ns(void)
+{
+	return timekeeper.ns + clocksource_cyc2ns(timekeeper.cs,
+						  __timekeeping_delta());
+}
+
+static void __timekeeping_fold(void)
+{
+	struct clocksource *cs = timekeeper.cs;
+	uint64_t cycles = cs->read();
+
+	write_seqcount_begin(&timekeeper.seq);
+	timekeeper.ns += clocksource_cyc2ns(cs, (cycles - timekeeper.cycle_last) &
+						cs->mask);
+	timekeeper.cycle_last = cycles;
+	write_seqcount_end(&timekeeper.seq);
+	timekeeper.fold = ticks + TICKS_PER_SEC;
+}
+
+/* The interrupts must be disabled. */
+struct clocksource *timekeeping_clocksource(void)
+{
+	return timekeeper.cs;
+}
+
+/* The interrupts must be disabled. */
+void timekeeping_set_clocksource(struct clocksource *cs)
 {
-	tv->tv_usec += USECS_PER_SEC / CONFIG_HZ;
-	if (tv->tv_usec > USECS_PER_SEC) {
-		tv->tv_sec += tv->tv_usec / USECS_PER_SEC;
-		tv->tv_usec = tv->tv_usec % USECS_PER_SEC;
+	__timekeeping_fold();
+	write_seqcount_begin(&timekeeper.seq);
+	timekeeper.cs = cs;
+	timekeeper.cycle_last = cs->read();
+	write_seqcount_end(&timekeeper.seq);
+}
+
+/* The interrupts must be disabled, or the timekeeper read under its seq. */
+uint64_t __timekeeping_abs_ns(clockid_t clk_id, const struct timespec *ts)
+{
+	uint64_t ns = timespec_to_ns(ts);
+
+	if (clk_id == CLOCK_REALTIME) {
+		if (ns < timekeeper.offset)
+			return 0;
+		ns -= timekeeper.offset;
 	}
+
+	return ns;
 }
 
-void timer_update(void)
+uint64_t timekeeping_abs_ns(clockid_t clk_id, const struct timespec *ts)
 {
-	unsigned long now = ++ticks;
+	unsigned long seq;
+	uint64_t ns;
 
-	update_timeval(&wall_clock.tv);
-	update_timeval(&monotonic_clock);
-	update_timeval(&pthread_current->stime);
+	do {
+		seq = read_seqcount_begin(&timekeeper.seq);
+		ns = __timekeeping_abs_ns(clk_id, ts);
+	} while (read_seqcount_retry(&timekeeper.seq, seq));
 
-	while (timer_context.n > 0 &&
-	       !time_after(timer_context.heap[0]->expires, now)) {
-		struct timer *timer = timer_context.heap[0];
+	return ns;
+}
 
-		__timer_delete(timer);
-		timer->func(timer);
+/* Reads the CLOCK_MONOTONIC ns, and the offset of CLOCK_REALTIME if asked. */
+static uint64_t timekeeping_read(uint64_t *offset)
+{
+	unsigned long seq;
+	uint64_t ns;
+
+	do {
+		seq = read_seqcount_begin(&timekeeper.seq);
+		ns = __timekeeping_ns();
+		if (offset)
+			*offset = timekeeper.offset;
+	} while (read_seqcount_retry(&timekeeper.seq, seq));
+
+	return ns;
+}
+
+uint64_t timekeeping_ns(void)
+{
+	return timekeeping_read(NULL);
+}
+
+/*
+ * The clock event device runs in the one-shot mode, and is programmed for the
+ * next tick or the earliest hrtimer, whichever comes first. The tick is
+ * emulated at tick_next, in CLOCK_MONOTONIC ns.
+ */
+static struct clock_event *clock_event;
+static uint64_t tick_next;
+#if CONFIG_NO_HZ
+static bool timer_idle;
+#endif
+
+/* The interrupts must be disabled. */
+void clock_event_reprogram(void)
+{
+	uint64_t next = tick_next, now, delta;
+
+	if (!clock_event)
+		return;
+#if CONFIG_NO_HZ
+	if (timer_idle) {
+		/* Skip the ticks up to the earliest timer, or the next fold. */
+		unsigned long n = timer_next(timekeeper.fold - ticks);
+
+		if ((long)n > 1)
+			next += (uint64_t)(n - 1) * NSECS_PER_TICK;
+	}
+#endif
+	next = MIN(next, hrtimer_next());
+	now = __timekeeping_ns();
+	delta = next > now ? next - now : 0;
+	delta = MAX(delta, clock_event->min_delta_ns);
+	delta = MIN(delta, clock_event->max_delta_ns);
+	clock_event->set_next_event(delta);
+}
+
+/*
+ * The device replaces the current one if it is rated higher. The last event
+ * programmed on the old one may still come, which only runs the due timers.
+ */
+void clock_event_register(struct clock_event *ce)
+{
+	unsigned long flags = interrupt_disable();
+
+	if (clock_event && ce->rating <= clock_event->rating) {
+		interrupt_enable(flags);
+		return;
 	}
+	if (!clock_event)
+		tick_next = __timekeeping_ns() + NSECS_PER_TICK;
+	clock_event = ce;
+	clock_event_reprogram();
+	printf("Clock event: %s\n", ce->name);
+	interrupt_enable(flags);
+}
+
+static void timer_tick(unsigned long n)
+{
+	unsigned long now;
+
+	ticks += n;
+	now = ticks;
+	if (!time_before(now, timekeeper.fold))
+		__timekeeping_fold();
+
+	timer_run(now);
 
 #if CONFIG_RR
-	if (--pthread_current->timeslice == 0)
-		pthread_next = NULL;
+	pthread_tick(n);
 #endif
 }
 
-time_t time(time_t *t)
+/* Runs the ticks and the hrtimers which are due, and reprograms the device. */
+static void __clock_event_run(void)
+{
+	uint64_t now = __timekeeping_ns(), n;
+
+	if (now >= tick_next) {
+		n = now - tick_next;
+		div64_32(&n, NSECS_PER_TICK);
+		n++;
+		tick_next += n * NSECS_PER_TICK;
+		timer_tick(n);
+	}
+	hrtimer_run(now);
+	clock_event_reprogram();
+}
+
+/* Called by the clock event device on its interrupt. */
+void clock_event_handler(void)
 {
-	if (t) {
-		*t = wall_clock.tv.tv_sec;
+	__clock_event_run();
+}
 
-		return *t;
-	} else {
-		return wall_clock.tv.tv_sec;
+#if CONFIG_NO_HZ
+/*
+ * Called by the idle thread with the interrupts disabled right before halting.
+ * Nothing but the timers can need the CPU before the next interrupt, so the
+ * ticks up to the earliest one are skipped.
+ */
+void timer_idle_enter(void)
+{
+#if CONFIG_SMP && CONFIG_RR
+	/* The threads of the other CPUs are charged on the ticks. */
+	if (pthread_tick_needed())
+		return;
+#endif
+	timer_idle = true;
+	clock_event_reprogram();
+}
+
+/* Called on the entry of every interrupt to catch up on the skipped ticks. */
+void timer_idle_exit(void)
+{
+	if (timer_idle) {
+		timer_idle = false;
+		__clock_event_run();
 	}
 }
+#endif
 
-int gettimeofday(struct timeval *tv, struct timezone *tz)
+time_t time(time_t *t)
 {
-	unsigned long flags = interrupt_disable();
+	struct timespec ts;
 
-	if (tv)
-		*tv = wall_clock.tv;
-	if (tz)
-		*tz = wall_clock.tz;
-	interrupt_enable(flags);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	if (t)
+		*t = ts.tv_sec;
+
+	return ts.tv_sec;
+}
+
+int gettimeofday(struct timeval *tv, struct timezone *tz)
+{
+	struct timespec ts;
+	uint64_t ns = 0;
+	unsigned long seq;
+
+	do {
+		seq = read_seqcount_begin(&timekeeper.seq);
+		if (tv)
+			ns = __timekeeping_ns() + timekeeper.offset;
+		if (tz)
+			*tz = wall_clock.tz;
+	} while (read_seqcount_retry(&timekeeper.seq, seq));
+	if (tv) {
+		ns_to_timespec(ns, &ts);
+		tv->tv_sec = ts.tv_sec;
+		tv->tv_usec = ts.tv_nsec / NSECS_PER_USEC;
+	}
 
 	return 0;
 }
 
 int settimeofday(const struct timeval *tv, const struct timezone *tz)
 {
+	struct timespec ts;
 	unsigned long flags = interrupt_disable();
 
-	if (tv)
-		wall_clock.tv = *tv;
+	write_seqcount_begin(&timekeeper.seq);
+	if (tv) {
+		ts.tv_sec = tv->tv_sec;
+		ts.tv_nsec = tv->tv_usec * NSECS_PER_USEC;
+		timekeeper.offset = timespec_to_ns(&ts) - __timekeeping_ns();
+	}
 	if (tz)
 		wall_clock.tz = *tz;
+	write_seqcount_end(&timekeeper.seq);
 	interrupt_enable(flags);
 
 	return 0;
@@ -279,35 +594,38 @@ int settimeofday(const struct timeval *tv, const struct timezone *tz)
 
 void uptime(struct timeval *tv)
 {
-	unsigned long flags = interrupt_disable();
+	struct timespec ts;
 
 	assert(tv);
-	*tv = monotonic_clock;
-	interrupt_enable(flags);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	tv->tv_sec = ts.tv_sec;
+	tv->tv_usec = ts.tv_nsec / NSECS_PER_USEC;
 }
 
 int clock_gettime(clockid_t clk_id, struct timespec *tp)
 {
-	int retval = 0;
-	unsigned long flags = interrupt_disable();
+	uint64_t ns, offset;
+	pthread_t thread;
 
 	switch (clk_id) {
 	case CLOCK_REALTIME:
-		tp->tv_sec = wall_clock.tv.tv_sec;
-		tp->tv_nsec = wall_clock.tv.tv_usec * NSECS_PER_USEC;
+		ns = timekeeping_read(&offset);
+		ns_to_timespec(ns + offset, tp);
 		break;
 	case CLOCK_MONOTONIC:
-		tp->tv_sec = monotonic_clock.tv_sec;
-		tp->tv_nsec = monotonic_clock.tv_usec * NSECS_PER_USEC;
+		ns_to_timespec(timekeeping_read(NULL), tp);
 		break;
 	default:
-		errno = EINVAL;
-		retval = -1;
+		thread = pthread_cpuclock_thread(clk_id);
+		if (!thread) {
+			errno = EINVAL;
+			return -1;
+		}
+		ns_to_timespec(pthread_cputime(thread), tp);
 		break;
 	}
-	interrupt_enable(flags);
 
-	return retval;
+	return 0;
 }
 
 int clock_settime(clockid_t clk_id, const struct timespec *tp)
@@ -317,8 +635,9 @@ int clock_settime(clockid_t clk_id, const struct timespec *tp)
 
 	switch (clk_id) {
 	case CLOCK_REALTIME:
-		wall_clock.tv.tv_sec = tp->tv_sec;
-		wall_clock.tv.tv_usec = tp->tv_nsec / NSECS_PER_USEC;
+		write_seqcount_begin(&timekeeper.seq);
+		timekeeper.offset = timespec_to_ns(tp) - __timekeeping_ns();
+		write_seqcount_end(&timekeeper.seq);
 		break;
 	case CLOCK_MONOTONIC:
 	default:
@@ -330,3 +649,40 @@ int clock_settime(clockid_t clk_id, const struct timespec *tp)
 
 	return retval;
 }
+
+/*
+ * There are no signals to interrupt the sleep, so it returns only at the
+ * deadline, and remain is never set.
+ */
+int clock_nanosleep(clockid_t clk_id, int flags,
+		    const struct timespec *request, struct timespec *remain)
+{
+	uint64_t expires;
+
+	(void)remain;
+	if (clk_id != CLOCK_REALTIME && clk_id != CLOCK_MONOTONIC)
+		return EINVAL;
+	if (!timespec_valid(request))
+		return EINVAL;
+	if (flags & TIMER_ABSTIME)
+		expires = timekeeping_abs_ns(clk_id, request);
+	else
+		expires = timekeeping_ns() + timespec_to_ns(request);
+	do {
+		pthread_current->state = PTHREAD_STATE_SLEEPING;
+	} while (schedule_hrtimeout(expires) > 0);
+
+	return 0;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+	int retval = clock_nanosleep(CLOCK_MONOTONIC, 0, req, rem);
+
+	if (retval) {
+		errno = retval;
+		return -1;
+	}
+
+	return 0;
+}